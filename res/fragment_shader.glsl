@@ -2,6 +2,7 @@
 
 // Interpolated values from the vertex shaders
 in vec2 UV;
+flat in float materialLayer;
 in vec3 normal;
 in vec3 vertex;
 in vec3 eye;
@@ -9,9 +10,35 @@ in vec3 light;
 
 out vec3 color;
 
+// Values that stay constant for the whole frame, shared by every object
+layout(std140) uniform Frame
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 Camera_Pos;
+	vec4 Light_Pos;
+	vec4 Light_Col;
+};
+
 // Values that stay constant for the whole mesh.
 uniform sampler2D Tex_Cube;
-uniform vec3 Light_Col;
+
+// When set UV is in tiles that repeat the block material given by materialLayer
+uniform bool Tiled_UV;
+uniform sampler2DArray Block_Materials;
+
+vec3 textureColor()
+{
+	if (!Tiled_UV)
+	{
+		return texture( Tex_Cube, UV ).rgb;
+	}
+
+	// Each layer repeats by itself, so tiles need no wrapping. Layer rows run from the bottom up
+	// while v runs down the face, as it did down the atlas.
+	return texture( Block_Materials, vec3(UV.x, 1.0 - UV.y, materialLayer) ).rgb;
+}
 
 void main()
 {
@@ -25,19 +52,22 @@ void main()
 	float distance = length(light - vertex);
 	distance = 1.0;
 
+	// Sample the texture once for all terms
+	vec3 tex_color = textureColor();
+
 	// Calculate ambient color
-	vec3 ambient = vec3(0.3, 0.3, 0.3) * texture( Tex_Cube, UV ).rgb;
+	vec3 ambient = vec3(0.3, 0.3, 0.3) * tex_color;
 
 	// Calculate diffuse color
 	float cos_angle = clamp(dot(norm, to_light), 0.0, 1.0);
-	vec3 diffuse = texture( Tex_Cube, UV ).rgb * Light_Col * cos_angle / (distance * distance);
+	vec3 diffuse = tex_color * Light_Col.rgb * cos_angle / (distance * distance);
 
 	// Calculate specular color
 	vec3 to_camera = normalize(eye - vertex);
 	vec3 reflection = reflect(-to_light, norm);
 
 	float cos_alpha = clamp(dot(to_camera, reflection), 0.0, 1.0);
-	vec3 specular = texture( Tex_Cube, UV ).rgb * Light_Col * pow(cos_alpha, 4) / (distance * distance);
+	vec3 specular = tex_color * Light_Col.rgb * pow(cos_alpha, 4) / (distance * distance);
 
 	color = ambient + diffuse + specular;
 }
@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec2 texel;
+in vec4 colour;
+
+out vec4 color;
+
+// One channel font, one texel per pixel of a glyph
+uniform sampler2D Font;
+
+void main()
+{
+	// Glyphs are drawn at whole multiples of their size, so each fragment takes one texel
+	float coverage = texelFetch( Font, ivec2(texel), 0 ).r;
+	color = vec4(colour.rgb, colour.a * coverage);
+}
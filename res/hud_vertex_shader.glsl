@@ -0,0 +1,20 @@
+#version 330 core
+
+// Corner of a text or graph quad, already in clip space
+layout(location = 0) in vec2 vertexPosition;
+
+// Texel of the font, the solid glyph for filled boxes
+layout(location = 1) in vec2 vertexTexel;
+
+// Colour with alpha
+layout(location = 2) in vec4 vertexColour;
+
+out vec2 texel;
+out vec4 colour;
+
+void main()
+{
+	gl_Position = vec4(vertexPosition, 0.0, 1.0);
+	texel = vertexTexel;
+	colour = vertexColour;
+}
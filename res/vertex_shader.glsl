@@ -9,16 +9,51 @@ layout(location = 1) in vec2 vertexUV;
 // The normal coordinates
 layout(location = 2) in vec3 vertexNormal;
 
+// Layer of the block material texture array (only used when tiling)
+layout(location = 3) in float vertexLayer;
+
+// Packed block vertex, replaces all of the above when Packed_Vertex is set
+layout(location = 4) in uvec2 vertexPacked;
+
+// Model matrix of each instance, replaces M when Instanced is set (takes locations 5 to 8)
+layout(location = 5) in mat4 instanceModel;
+
+// Values that stay constant for the whole frame, shared by every object
+layout(std140) uniform Frame
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 Camera_Pos;
+	vec4 Light_Pos;
+	vec4 Light_Col;
+};
+
 // Values that stay constant for the whole mesh.
-uniform mat4 MVP;	
-uniform mat4 M;	
-uniform mat4 V;	
-uniform vec3 Camera_Pos;
-uniform vec3 Light_Pos;
+uniform mat4 M;
+uniform bool Packed_Vertex;
+uniform bool Instanced;
+
+// When set packed vertices are offset by their block's origin, looked up by the slot in the vertex
+uniform bool Shared_Geometry;
+uniform samplerBuffer Chunk_Origins;
+
+// Block face normals indexed by the packed vertex
+const vec3 face_normals[6] = vec3[6](
+	vec3(0.0, 1.0, 0.0),
+	vec3(0.0, -1.0, 0.0),
+	vec3(0.0, 0.0, -1.0),
+	vec3(0.0, 0.0, 1.0),
+	vec3(-1.0, 0.0, 0.0),
+	vec3(1.0, 0.0, 0.0)
+);
 
 // Output tex coords
 out vec2 UV;
 
+// Output material layer
+flat out float materialLayer;
+
 // Output normal
 out vec3 normal;
 
@@ -33,21 +68,41 @@ out vec3 light;
 
 void main()
 {
-	// Output position of the vertex, in clip space : MVP * position
-	gl_Position =  MVP * vec4(vertexPosition_modelspace,1);
-
-	// UV of vertex
+	vec3 position = vertexPosition_modelspace;
+	vec3 vnormal = vertexNormal;
 	UV = vertexUV;
+	materialLayer = vertexLayer;
+
+	if (Packed_Vertex)
+	{
+		// Corners are stored as integers, block centres are on whole numbers
+		uint geometry = vertexPacked.x;
+		position = vec3(float(geometry & 31u), float((geometry >> 5) & 31u), float((geometry >> 10) & 31u)) - 0.5;
+		vnormal = face_normals[(geometry >> 15) & 7u];
+		UV = vec2(float((geometry >> 18) & 31u), float((geometry >> 23) & 31u));
+
+		materialLayer = float(vertexPacked.y & 0xffffu);
+
+		if (Shared_Geometry)
+		{
+			position += texelFetch(Chunk_Origins, int(vertexPacked.y >> 16)).xyz;
+		}
+	}
+
+	mat4 model = Instanced ? instanceModel : M;
+
+	// Output position of the vertex, in clip space : VP * M * position
+	gl_Position =  VP * model * vec4(position,1);
 
 	// Normal
-	normal = (V * M * vec4(vertexNormal,0)).xyz;
+	normal = (V * model * vec4(vnormal,0)).xyz;
 
 	// Vertex
-	vertex = (V * M * vec4(vertexPosition_modelspace,1)).xyz;
+	vertex = (V * model * vec4(position,1)).xyz;
 
 	// Eye
-	eye = (V * vec4(Camera_Pos, 1)).xyz;
+	eye = (V * vec4(Camera_Pos.xyz, 1)).xyz;
 
 	// Light
-	light = (V * vec4(Light_Pos, 1)).xyz;
+	light = (V * vec4(Light_Pos.xyz, 1)).xyz;
 }
@@ -1,6 +1,9 @@
 #ifndef __ANT_ATTACK_HPP__
 #define __ANT_ATTACK_HPP__
 
+// Ant Attack map is 128x128 columns with a bit set for each of the six stone layers
+constexpr int ant_attack_size = 128;
+
 static int map_data[] = {
 	0x3f,  0x0f,  0x0f,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x03,  0x07,  0x03,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x0f,  0x0f,  0x0f,  0x0f,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x1b,  0x1b,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x0f,  0x1b,  0x1b,  0x0f,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x1f,  0x1b,  0x3b,  0x1b,  0x1b,  0x1f,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x03,  0x03,  0x07,  0x0f,  0x3f, 
 	0x0f,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x03,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x03,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x00,  0x0f, 
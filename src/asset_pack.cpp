@@ -0,0 +1,90 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include "asset_pack.hpp"
+
+AssetPack::AssetPack(const string &path) : file(path)
+{
+	if (!file.isValid())
+	{
+		return;
+	}
+
+	Header header;
+	if (file.size() < sizeof(header))
+	{
+		cerr << "Asset pack " << path << " is too short\n";
+		return;
+	}
+
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version)
+	{
+		cerr << "Asset pack " << path << " is not a version " << Version << " pack\n";
+		return;
+	}
+
+	if (sizeof(Header) + static_cast<size_t>(header.num_entries) * sizeof(Entry) > file.size())
+	{
+		cerr << "Asset pack " << path << " is truncated\n";
+		return;
+	}
+
+	// Entries are read in place, they are aligned within the mapping
+	const Entry *table = reinterpret_cast<const Entry*>(file.data() + sizeof(Header));
+	for (uint32_t i=0; i<header.num_entries; i++)
+	{
+		const Entry &entry = table[i];
+		if (entry.offset % Alignment != 0 || entry.offset > file.size() || entry.size > file.size() - entry.offset ||
+			memchr(entry.name, 0, sizeof(entry.name)) == nullptr || !isComplete(entry))
+		{
+			cerr << "Asset pack " << path << " has a corrupt entry, ignoring the pack\n";
+			entries.clear();
+			return;
+		}
+
+		entries.emplace(entry.name, &entry);
+	}
+
+	valid = true;
+}
+
+bool AssetPack::isComplete(const Entry &entry) const
+{
+	const uint32_t *params = entry.params;
+	switch (entry.type)
+	{
+	case TypeShader:
+		return entry.size > 0 && data(entry)[entry.size - 1] == 0;
+	case TypeTexture:
+		return params[0] > 0 && params[1] > 0 && params[2] > 0 && params[2] <= 32 &&
+			levelOffset(params[0], params[1], params[2]) == entry.size;
+	case TypeMesh:
+		return (static_cast<uint64_t>(params[0]) * params[2] + params[1]) * 4 == entry.size;
+	}
+
+	// Kinds of asset from later versions of the packer are left alone
+	return true;
+}
+
+const AssetPack::Entry *AssetPack::find(const string &name, Type type) const
+{
+	auto found = entries.find(name);
+	if (found == entries.end() || found->second->type != static_cast<uint32_t>(type))
+	{
+		return nullptr;
+	}
+	return found->second;
+}
+
+size_t AssetPack::levelOffset(uint32_t width, uint32_t height, uint32_t level)
+{
+	size_t offset = 0;
+	for (uint32_t i=0; i<level; i++)
+	{
+		offset += static_cast<size_t>(width) * height * 4;
+		width = max(width / 2, 1u);
+		height = max(height / 2, 1u);
+	}
+	return offset;
+}
@@ -0,0 +1,76 @@
+#ifndef __ASSET_PACK_HPP__
+#define __ASSET_PACK_HPP__
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include "mapped_file.hpp"
+
+using namespace std;
+
+/**
+ * A single file of assets prepared offline by orbis_pack: shader source, textures with their whole
+ * mip chain decoded to RGBA, and OBJ models already parsed into vertex and index buffers. The file
+ * is memory mapped and each asset starts on its own page, so loading one hands a pointer into the
+ * mapping straight to GL with no parsing or copying.
+ *
+ * Assets are found by the path they were packed from, e.g. "res/vertex_shader.glsl", so a pack can
+ * stand in for the loose files under the same names.
+ */
+class AssetPack
+{
+public:
+	enum Type
+	{
+		TypeShader = 1,  // Source text followed by a terminating zero
+		TypeTexture = 2, // RGBA levels, largest first, each half the size of the one before
+		TypeMesh = 3     // ObjParser::Stride floats per vertex followed by the uint32_t indices
+	};
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t num_entries;
+		uint32_t reserved;
+	};
+
+	/// Follows the header, one for each asset.
+	struct Entry
+	{
+		char name[64];
+		uint32_t type;      // One of Type
+		uint32_t params[3]; // Width, height and levels of a texture, vertices, indices and stride of a mesh
+		uint64_t offset;    // Start of the data in the file, a multiple of Alignment
+		uint64_t size;      // Bytes of data
+	};
+
+	static constexpr char Magic[4] = { 'O', 'R', 'B', 'P' };
+	static constexpr uint32_t Version = 1;
+	static constexpr size_t Alignment = 4096;
+
+	/// Map a pack, reporting any problem with it. An invalid pack has no assets.
+	AssetPack(const string &path);
+
+	bool isValid() const { return valid; }
+
+	/// The asset packed from this path, nullptr if there isn't one of the given type.
+	const Entry *find(const string &name, Type type) const;
+
+	const uint8_t *data(const Entry &entry) const { return reinterpret_cast<const uint8_t*>(file.data()) + entry.offset; }
+
+	/// Offset of a texture level from the start of the texture's data.
+	static size_t levelOffset(uint32_t width, uint32_t height, uint32_t level);
+
+private:
+	// Whether the data is the size its parameters say, so reading it stays inside the file
+	bool isComplete(const Entry &entry) const;
+
+	MappedFile file;
+	bool valid = false;
+	unordered_map<string, const Entry*> entries;
+};
+
+#endif // __ASSET_PACK_HPP__
@@ -0,0 +1,384 @@
+// Times the CPU side hot paths of Orbis, meshing, OBJ parsing and PNG decoding, without a window.
+// Run with "make bench", optionally passing a filter such as BENCH_FILTER=mesh/greedy.
+
+#include <png.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <unistd.h>
+
+#include "blockinstance.hpp"
+#include "obj_parser.hpp"
+#include "mesh_optimizer.hpp"
+#include "image.hpp"
+#include "ant_attack.hpp"
+
+using namespace std;
+
+// Every case runs at least MinRuns times and for at least MinSeconds after a warm up run, and the
+// median is reported, so one slow run from the rest of the machine doesn't move the numbers
+constexpr int MinRuns = 10;
+constexpr double MinSeconds = 0.5;
+
+// Written to by every case so the compiler can't throw the work away
+static volatile size_t sink = 0;
+
+static string filter;
+
+// Time a case and print a line of the results: median and fastest run, the rate at which it gets
+// through its items and a note of what it produced, to spot a change in output as well as speed
+template<typename Work>
+static void run(const string &name, double items, const char *unit, Work work)
+{
+	if (!filter.empty() && name.find(filter) == string::npos)
+	{
+		return;
+	}
+
+	string detail = work();
+
+	vector<double> runs;
+	double total = 0.0;
+	while (runs.size() < MinRuns || total < MinSeconds)
+	{
+		auto start = chrono::steady_clock::now();
+		work();
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+		runs.push_back(elapsed.count());
+		total += elapsed.count();
+	}
+
+	nth_element(runs.begin(), runs.begin() + runs.size() / 2, runs.end());
+	double median = runs[runs.size() / 2];
+	double fastest = *min_element(runs.begin(), runs.end());
+
+	printf("%-34s %12.2f %12.2f %12.1f %-9s %s\n", name.c_str(), median * 1.0e6, fastest * 1.0e6, items / median, unit,
+		   detail.c_str());
+	fflush(stdout);
+}
+
+// Snapshot with every voxel, including the border, set by a function of its coordinates
+template<typename Voxel>
+static BlockInstance::Snapshot makeSnapshot(Voxel voxel)
+{
+	BlockInstance::Snapshot snapshot;
+	snapshot.voxels.assign(BlockInstance::Snapshot::Width * BlockInstance::Snapshot::Height * BlockInstance::Snapshot::Depth,
+						   BlockInstance::Block::Empty);
+
+	bool uniform = true;
+	BlockInstance::Block first = voxel(0, 0, 0);
+	for (int z=-1; z<=BLOCK_DEPTH; z++)
+	{
+		for (int y=-1; y<=BLOCK_HEIGHT; y++)
+		{
+			for (int x=-1; x<=BLOCK_WIDTH; x++)
+			{
+				BlockInstance::Block type = voxel(x, y, z);
+				snapshot.at(x, y, z) = type;
+
+				bool inside = x >= 0 && x < BLOCK_WIDTH && y >= 0 && y < BLOCK_HEIGHT && z >= 0 && z < BLOCK_DEPTH;
+				uniform = uniform && (!inside || type == first);
+			}
+		}
+	}
+
+	snapshot.uniform = uniform;
+	snapshot.uniform_type = first;
+	return snapshot;
+}
+
+// Every block of the built in map, laid out as loadAntAttackChunk does with the map's neighbours
+// in the borders
+static vector<BlockInstance::Snapshot> antAttackSnapshots()
+{
+	auto voxel = [](int x, int y, int z)
+	{
+		if (x < 0 || x >= ant_attack_size || z < 0 || z >= ant_attack_size || y < 0 || y > 6)
+		{
+			return BlockInstance::Block::Empty;
+		}
+		if (y == 0)
+		{
+			return BlockInstance::Block::Topsoil;
+		}
+		return (map_data[z * ant_attack_size + x] & (0x1 << (y - 1))) != 0 ? BlockInstance::Block::Stone : BlockInstance::Block::Empty;
+	};
+
+	vector<BlockInstance::Snapshot> snapshots;
+	for (int bz=0; bz<ant_attack_size / BLOCK_DEPTH; bz++)
+	{
+		for (int bx=0; bx<ant_attack_size / BLOCK_WIDTH; bx++)
+		{
+			snapshots.push_back(makeSnapshot([&](int x, int y, int z) { return voxel(bx * BLOCK_WIDTH + x, y, bz * BLOCK_DEPTH + z); }));
+		}
+	}
+	return snapshots;
+}
+
+static void benchMeshing()
+{
+	struct Case
+	{
+		const char *name;
+		vector<BlockInstance::Snapshot> snapshots;
+	};
+
+	// Worst case for every mesher (no face is hidden or can be merged), best case for greedy
+	// meshing, the early out for air, and a real map
+	vector<Case> cases;
+	cases.push_back({ "checkerboard", { makeSnapshot([](int x, int y, int z)
+		{ return ((x + y + z) & 1) != 0 ? BlockInstance::Block::Stone : BlockInstance::Block::Empty; }) } });
+	cases.push_back({ "solid", { makeSnapshot([](int x, int y, int z)
+		{
+			bool inside = x >= 0 && x < BLOCK_WIDTH && y >= 0 && y < BLOCK_HEIGHT && z >= 0 && z < BLOCK_DEPTH;
+			return inside ? BlockInstance::Block::Stone : BlockInstance::Block::Empty;
+		}) } });
+	cases.push_back({ "empty", { makeSnapshot([](int, int, int) { return BlockInstance::Block::Empty; }) } });
+	cases.push_back({ "ant_attack", antAttackSnapshots() });
+
+	struct Mode
+	{
+		const char *name;
+		BlockInstance::MeshMode mode;
+		BlockInstance::VertexFormat format;
+		int level;
+	};
+
+	const Mode modes[] = {
+		{ "naive", BlockInstance::MeshNaive, BlockInstance::FormatPacked, 0 },
+		{ "culled", BlockInstance::MeshCulled, BlockInstance::FormatPacked, 0 },
+		{ "greedy", BlockInstance::MeshGreedy, BlockInstance::FormatPacked, 0 },
+		{ "greedy_float", BlockInstance::MeshGreedy, BlockInstance::FormatFloat, 0 },
+		{ "greedy_lod2", BlockInstance::MeshGreedy, BlockInstance::FormatPacked, 2 },
+	};
+
+	for (const auto &mode : modes)
+	{
+		for (const auto &test : cases)
+		{
+			run(string("mesh/") + mode.name + "/" + test.name, static_cast<double>(test.snapshots.size()), "chunks/s", [&]()
+			{
+				BlockInstance::Mesh mesh;
+				size_t faces = 0;
+				for (const auto &snapshot : test.snapshots)
+				{
+					BlockInstance::buildMesh(snapshot, mode.mode, mode.format, mesh, mode.level);
+					faces += mesh.faces_emitted;
+				}
+				sink = sink + faces;
+				return to_string(faces) + " faces";
+			});
+		}
+	}
+}
+
+// Rolling terrain of size x size quads with positions, texture coordinates and normals, the way
+// modelling tools write it
+static string generateObj(int size)
+{
+	string text = "# Generated by bench_orbis\no terrain\n";
+	char line[128];
+
+	auto height = [](int x, int z) { return 2.0f * sinf(x * 0.11f) * cosf(z * 0.07f); };
+	for (int z=0; z<=size; z++)
+	{
+		for (int x=0; x<=size; x++)
+		{
+			snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x * 0.5f, height(x, z), z * 0.5f);
+			text += line;
+		}
+	}
+	for (int z=0; z<=size; z++)
+	{
+		for (int x=0; x<=size; x++)
+		{
+			snprintf(line, sizeof(line), "vt %.6f %.6f\n", static_cast<float>(x) / size, static_cast<float>(z) / size);
+			text += line;
+		}
+	}
+	for (int z=0; z<=size; z++)
+	{
+		for (int x=0; x<=size; x++)
+		{
+			float dx = height(x + 1, z) - height(x - 1, z);
+			float dz = height(x, z + 1) - height(x, z - 1);
+			float length = sqrtf(dx * dx + 1.0f + dz * dz);
+			snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", -dx / length, 1.0f / length, -dz / length);
+			text += line;
+		}
+	}
+
+	for (int z=0; z<size; z++)
+	{
+		for (int x=0; x<size; x++)
+		{
+			int a = z * (size + 1) + x + 1;
+			int b = a + size + 1;
+			snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+			text += line;
+		}
+	}
+
+	return text;
+}
+
+static void benchObj()
+{
+	string text = generateObj(512);
+	double megabytes = text.size() / (1024.0 * 1024.0);
+	unsigned threads = max(thread::hardware_concurrency(), 1u);
+
+	run("obj/parse/1_thread", megabytes, "MB/s", [&]()
+	{
+		ObjParser::Mesh mesh;
+		ObjParser::parse(text.data(), text.size(), mesh, nullptr, 1);
+		sink = sink + mesh.indices.size();
+		return to_string(mesh.indices.size() / 3) + " triangles";
+	});
+
+	run("obj/parse/all_threads", megabytes, "MB/s", [&]()
+	{
+		ObjParser::Mesh mesh;
+		ObjParser::parse(text.data(), text.size(), mesh, nullptr, threads);
+		sink = sink + mesh.indices.size();
+		return to_string(mesh.numVertices()) + " vertices on " + to_string(threads) + " threads";
+	});
+
+	// What WavefrontObj does with the parsed mesh before uploading it
+	ObjParser::Mesh parsed;
+	ObjParser::parse(text.data(), text.size(), parsed);
+	double triangles = parsed.indices.size() / 3.0;
+	run("obj/optimize_vertex_cache", triangles, "tris/s", [&]()
+	{
+		vector<uint32_t> indices = parsed.indices;
+		MeshOptimizer::optimizeVertexCache(indices, parsed.numVertices());
+		sink = sink + indices[0];
+		char ratio[32];
+		snprintf(ratio, sizeof(ratio), "%.3f ACMR", MeshOptimizer::averageCacheMissRatio(indices, parsed.numVertices()));
+		return string(ratio);
+	});
+}
+
+// Write a deterministic RGBA picture, smooth in places and noisy in others like a real texture
+static bool writePng(const char *filename, int width, int height)
+{
+	FILE *file = fopen(filename, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : nullptr;
+	if (!info_ptr || setjmp(png_jmpbuf(png_ptr)))
+	{
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		fclose(file);
+		return false;
+	}
+
+	png_init_io(png_ptr, file);
+	png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+				 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png_ptr, info_ptr);
+
+	vector<png_byte> row(width * 4);
+	uint32_t noise = 12345;
+	for (int y=0; y<height; y++)
+	{
+		for (int x=0; x<width; x++)
+		{
+			noise = noise * 1664525u + 1013904223u;
+			bool rough = ((x / 64) + (y / 64)) & 1;
+			row[x * 4 + 0] = static_cast<png_byte>(x + (rough ? (noise >> 28) : 0));
+			row[x * 4 + 1] = static_cast<png_byte>(y + (rough ? (noise >> 24) & 15 : 0));
+			row[x * 4 + 2] = static_cast<png_byte>((x ^ y) >> 2);
+			row[x * 4 + 3] = 255;
+		}
+		png_write_row(png_ptr, row.data());
+	}
+
+	png_write_end(png_ptr, nullptr);
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+	return fclose(file) == 0;
+}
+
+static void benchPng()
+{
+	auto decode = [](const string &filename, const string &name)
+	{
+		Image probe;
+		if (!probe.loadPng(filename.c_str()))
+		{
+			return;
+		}
+
+		double megapixels = probe.width() * static_cast<double>(probe.height()) / 1.0e6;
+		run("png/decode/" + name, megapixels, "Mpixels/s", [&]()
+		{
+			Image image;
+			image.loadPng(filename.c_str());
+			sink = sink + image.size();
+			return to_string(image.width()) + "x" + to_string(image.height());
+		});
+
+		// Texture builds the rest of the mip chain from the decoded image
+		run("png/mip_chain/" + name, megapixels, "Mpixels/s", [&]()
+		{
+			Image level = probe;
+			while (level.width() > 1 || level.height() > 1)
+			{
+				level = level.halved();
+			}
+			sink = sink + level.data()[0];
+			return to_string(Image::numLevels(probe.width(), probe.height())) + " levels";
+		});
+	};
+
+	decode("res/blockinstance.png", "blockinstance");
+
+	char filename[] = "/tmp/bench_orbisXXXXXX";
+	int fd = mkstemp(filename);
+	if (fd < 0)
+	{
+		cerr << "Unable to create a temporary PNG\n";
+		return;
+	}
+	close(fd);
+
+	if (writePng(filename, 2048, 2048))
+	{
+		decode(filename, "generated");
+	}
+	else
+	{
+		cerr << "Unable to write " << filename << endl;
+	}
+	remove(filename);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 2)
+	{
+		cerr << "Usage: " << argv[0] << " [filter]\n";
+		return 1;
+	}
+	if (argc == 2)
+	{
+		filter = argv[1];
+	}
+
+	printf("%-34s %12s %12s %12s %-9s %s\n", "benchmark", "median us", "min us", "rate", "", "output");
+	benchMeshing();
+	benchObj();
+	benchPng();
+
+	return 0;
+}
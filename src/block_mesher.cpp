@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <chrono>
+#include "block_mesher.hpp"
+
+BlockMesher::BlockMesher(unsigned num_threads)
+{
+	if (num_threads == 0)
+	{
+		unsigned hardware_threads = thread::hardware_concurrency();
+		num_threads = hardware_threads > 1 ? hardware_threads - 1 : 1;
+	}
+
+	for (unsigned i=0; i<num_threads; i++)
+	{
+		workers.emplace_back(&BlockMesher::run, this);
+	}
+}
+
+BlockMesher::~BlockMesher()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	work_ready.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void BlockMesher::submit(BlockInstance &block)
+{
+	Job job;
+	job.block = &block;
+	job.snapshot = block.snapshot();
+	job.generation = block.meshGeneration();
+	job.centre = block.centre();
+	job.mode = block.meshMode();
+	job.format = block.vertexFormat();
+	job.lod_levels = block.lodLevels();
+
+	{
+		lock_guard<mutex> guard(lock);
+		job.id = next_id++;
+
+		// A request that hasn't been started yet can simply be brought up to date
+		for (auto &queued_job : queued)
+		{
+			if (queued_job.block == &block)
+			{
+				queued_job = move(job);
+				return;
+			}
+		}
+
+		queued.push_back(move(job));
+	}
+	work_ready.notify_one();
+}
+
+void BlockMesher::cancel(BlockInstance &block)
+{
+	lock_guard<mutex> guard(lock);
+
+	auto is_block = [&block](const Job &job) { return job.block == &block; };
+	queued.erase(remove_if(queued.begin(), queued.end(), is_block), queued.end());
+	finished.erase(remove_if(finished.begin(), finished.end(), is_block), finished.end());
+
+	// Workers check this list before handing their results over
+	in_flight.erase(remove_if(in_flight.begin(), in_flight.end(),
+							  [&block](const pair<uint64_t, BlockInstance*> &entry) { return entry.second == &block; }),
+					in_flight.end());
+}
+
+void BlockMesher::setViewer(const glm::vec3 &position)
+{
+	lock_guard<mutex> guard(lock);
+	viewer = position;
+}
+
+size_t BlockMesher::upload(float budget_ms)
+{
+	auto start = chrono::steady_clock::now();
+	size_t uploaded = 0;
+
+	while (true)
+	{
+		Job job;
+		{
+			lock_guard<mutex> guard(lock);
+			if (finished.empty())
+			{
+				break;
+			}
+
+			size_t i = nearest(finished, viewer);
+			job = move(finished[i]);
+			if (i != finished.size() - 1)
+			{
+				finished[i] = move(finished.back());
+			}
+			finished.pop_back();
+		}
+
+		// A newer mesh for this block has been requested since, so wait for that one instead
+		if (job.generation != job.block->meshGeneration())
+		{
+			continue;
+		}
+
+		for (int level=0; level<job.lod_levels; level++)
+		{
+			job.block->uploadMesh(job.meshes[level], level);
+		}
+		uploaded++;
+
+		chrono::duration<float, milli> elapsed = chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budget_ms)
+		{
+			break;
+		}
+	}
+
+	return uploaded;
+}
+
+size_t BlockMesher::pending() const
+{
+	lock_guard<mutex> guard(lock);
+	return queued.size() + in_flight.size() + finished.size();
+}
+
+void BlockMesher::run()
+{
+	while (true)
+	{
+		Job job;
+		{
+			unique_lock<mutex> guard(lock);
+			work_ready.wait(guard, [this] { return stopping || !queued.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			size_t i = nearest(queued, viewer);
+			job = move(queued[i]);
+			if (i != queued.size() - 1)
+			{
+				queued[i] = move(queued.back());
+			}
+			queued.pop_back();
+
+			in_flight.push_back(make_pair(job.id, job.block));
+		}
+
+		job.meshes.resize(job.lod_levels);
+		for (int level=0; level<job.lod_levels; level++)
+		{
+			BlockInstance::buildMesh(job.snapshot, job.mode, job.format, job.meshes[level], level);
+		}
+		job.snapshot = BlockInstance::Snapshot();
+
+		{
+			lock_guard<mutex> guard(lock);
+
+			// The block was cancelled while being meshed
+			auto entry = find_if(in_flight.begin(), in_flight.end(),
+								 [&job](const pair<uint64_t, BlockInstance*> &entry) { return entry.first == job.id; });
+			if (entry == in_flight.end())
+			{
+				continue;
+			}
+
+			in_flight.erase(entry);
+			finished.push_back(move(job));
+		}
+	}
+}
+
+size_t BlockMesher::nearest(const vector<Job> &jobs, const glm::vec3 &position)
+{
+	size_t best = 0;
+	float best_distance = 0.0f;
+
+	for (size_t i=0; i<jobs.size(); i++)
+	{
+		glm::vec3 offset = jobs[i].centre - position;
+		float distance = glm::dot(offset, offset);
+		if (i == 0 || distance < best_distance)
+		{
+			best = i;
+			best_distance = distance;
+		}
+	}
+
+	return best;
+}
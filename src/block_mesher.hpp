@@ -0,0 +1,81 @@
+#ifndef __BLOCK_MESHER_HPP__
+#define __BLOCK_MESHER_HPP__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <utility>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "blockinstance.hpp"
+
+using namespace std;
+
+/**
+ * Builds block meshes on background threads. Blocks are snapshotted when they are submitted so
+ * they can carry on being edited, and finished meshes are only uploaded when the render thread
+ * asks for them. Until then a block keeps drawing whatever mesh it had before. All of a block's
+ * levels of detail are built by the same job and uploaded together.
+ */
+class BlockMesher
+{
+public:
+	/// Zero threads picks one less than the number of hardware threads (but at least one).
+	BlockMesher(unsigned num_threads = 0);
+	~BlockMesher();
+
+	/// Queue a block to be remeshed, replacing any request for it that hasn't started yet.
+	void submit(BlockInstance &block);
+
+	/// Forget about a block, e.g. before it is destroyed. Meshes already being built are dropped.
+	void cancel(BlockInstance &block);
+
+	/// Position that work is prioritised around, nearest first. Call once per frame.
+	void setViewer(const glm::vec3 &position);
+
+	/// Upload finished meshes nearest the viewer first until the time budget is spent. At least one
+	/// mesh is uploaded per call when available. Returns the number uploaded.
+	size_t upload(float budget_ms);
+
+	/// Blocks that have been submitted but not yet uploaded.
+	size_t pending() const;
+
+	size_t numThreads() const { return workers.size(); }
+
+private:
+	struct Job
+	{
+		uint64_t id;
+		BlockInstance *block;
+		unsigned generation;
+		glm::vec3 centre;
+		BlockInstance::MeshMode mode;
+		BlockInstance::VertexFormat format;
+		int lod_levels;
+		BlockInstance::Snapshot snapshot;
+		vector<BlockInstance::Mesh> meshes; // One per level of detail
+	};
+
+	void run();
+	static size_t nearest(const vector<Job> &jobs, const glm::vec3 &position);
+
+	vector<thread> workers;
+
+	mutable mutex lock;
+	condition_variable work_ready;
+	bool stopping = false;
+
+	uint64_t next_id = 0;
+	glm::vec3 viewer = glm::vec3(0, 0, 0);
+
+	vector<Job> queued;
+	vector<pair<uint64_t, BlockInstance*>> in_flight;
+	vector<Job> finished;
+};
+
+#endif // __BLOCK_MESHER_HPP__
@@ -0,0 +1,184 @@
+#include <cassert>
+#include "block_storage.hpp"
+
+BlockStorage::BlockStorage(size_t size, int32_t value) : size(size)
+{
+	palette.push_back(value);
+	counts.push_back(size);
+}
+
+void BlockStorage::set(size_t index, int32_t value)
+{
+	assert(index < size);
+
+	if (bits_per_index == 0)
+	{
+		if (palette[0] == value)
+		{
+			return;
+		}
+
+		// Every voxel starts off pointing at the current single entry
+		repack(1);
+	}
+
+	uint32_t old_entry = readIndex(index);
+	if (palette[old_entry] == value)
+	{
+		return;
+	}
+
+	uint32_t entry = findOrAdd(value);
+	writeIndex(index, entry);
+	counts[entry]++;
+
+	counts[old_entry]--;
+	if (counts[old_entry] == 0)
+	{
+		release(old_entry);
+	}
+}
+
+size_t BlockStorage::memoryUsage() const
+{
+	size_t bytes = sizeof(*this);
+	bytes += words.capacity() * sizeof(uint64_t);
+	bytes += palette.capacity() * sizeof(int32_t);
+	bytes += counts.capacity() * sizeof(uint32_t);
+	bytes += free_entries.capacity() * sizeof(uint32_t);
+
+	// Rough cost of a node plus its bucket
+	bytes += lookup.size() * (sizeof(pair<int32_t, uint32_t>) + 2 * sizeof(void*));
+	bytes += lookup.bucket_count() * sizeof(void*);
+
+	return bytes;
+}
+
+void BlockStorage::writeIndex(size_t index, uint32_t entry)
+{
+	size_t bit = index * bits_per_index;
+	uint64_t &word = words[bit / 64];
+	word &= ~(mask << (bit % 64));
+	word |= static_cast<uint64_t>(entry) << (bit % 64);
+}
+
+uint32_t BlockStorage::findOrAdd(int32_t value)
+{
+	if (use_lookup)
+	{
+		auto found = lookup.find(value);
+		if (found != lookup.end())
+		{
+			return found->second;
+		}
+	}
+	else
+	{
+		for (uint32_t i=0; i<palette.size(); i++)
+		{
+			if (counts[i] > 0 && palette[i] == value)
+			{
+				return i;
+			}
+		}
+	}
+
+	uint32_t entry;
+	if (!free_entries.empty())
+	{
+		entry = free_entries.back();
+		free_entries.pop_back();
+		palette[entry] = value;
+	}
+	else
+	{
+		entry = palette.size();
+		palette.push_back(value);
+		counts.push_back(0);
+
+		if (palette.size() > (size_t(1) << bits_per_index))
+		{
+			repack(bits_per_index * 2);
+		}
+	}
+
+	if (!use_lookup && paletteSize() > LinearSearchLimit)
+	{
+		use_lookup = true;
+		for (uint32_t i=0; i<palette.size(); i++)
+		{
+			if (counts[i] > 0)
+			{
+				lookup[palette[i]] = i;
+			}
+		}
+	}
+
+	if (use_lookup)
+	{
+		lookup[value] = entry;
+	}
+
+	return entry;
+}
+
+void BlockStorage::release(uint32_t entry)
+{
+	free_entries.push_back(entry);
+	if (use_lookup)
+	{
+		lookup.erase(palette[entry]);
+	}
+
+	if (paletteSize() == 1)
+	{
+		collapse();
+	}
+}
+
+void BlockStorage::repack(unsigned new_bits)
+{
+	assert(new_bits <= 16);
+
+	vector<uint64_t> new_words((size * new_bits + 63) / 64, 0);
+	uint64_t new_mask = (uint64_t(1) << new_bits) - 1;
+
+	if (bits_per_index > 0)
+	{
+		for (size_t i=0; i<size; i++)
+		{
+			size_t bit = i * new_bits;
+			new_words[bit / 64] |= static_cast<uint64_t>(readIndex(i)) << (bit % 64);
+		}
+	}
+
+	words.swap(new_words);
+	bits_per_index = new_bits;
+	mask = new_mask;
+}
+
+void BlockStorage::collapse()
+{
+	// Only one entry is still referenced so the indices carry no information
+	int32_t value = 0;
+	for (uint32_t i=0; i<palette.size(); i++)
+	{
+		if (counts[i] > 0)
+		{
+			value = palette[i];
+		}
+	}
+
+	palette.assign(1, value);
+	palette.shrink_to_fit();
+	counts.assign(1, size);
+	counts.shrink_to_fit();
+	vector<uint32_t>().swap(free_entries);
+	unordered_map<int32_t, uint32_t>().swap(lookup);
+	use_lookup = false;
+
+	words.clear();
+	words.shrink_to_fit();
+	bits_per_index = 0;
+	mask = 0;
+}
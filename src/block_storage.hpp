@@ -0,0 +1,67 @@
+#ifndef __BLOCK_STORAGE_HPP__
+#define __BLOCK_STORAGE_HPP__
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * Palette compressed storage for the voxels of a block. Each distinct value is stored once in a
+ * palette and voxels hold bit packed indices into it, using 1, 2, 4, 8 or 16 bits as needed. A
+ * block holding a single value keeps no indices at all.
+ */
+class BlockStorage
+{
+public:
+	BlockStorage(size_t size, int32_t value);
+
+	int32_t get(size_t index) const
+	{
+		return bits_per_index == 0 ? palette[0] : palette[readIndex(index)];
+	}
+
+	void set(size_t index, int32_t value);
+
+	/// True when every voxel has the same value, which is then uniformValue().
+	bool isUniform() const { return bits_per_index == 0; }
+	int32_t uniformValue() const { return palette[0]; }
+
+	size_t paletteSize() const { return palette.size() - free_entries.size(); }
+	unsigned bitsPerIndex() const { return bits_per_index; }
+
+	/// Approximate number of bytes of memory in use, including the object itself.
+	size_t memoryUsage() const;
+
+private:
+	// Beyond this many entries a hash map is kept to find palette entries
+	static constexpr size_t LinearSearchLimit = 16;
+
+	uint32_t readIndex(size_t index) const
+	{
+		size_t bit = index * bits_per_index;
+		return static_cast<uint32_t>((words[bit / 64] >> (bit % 64)) & mask);
+	}
+
+	void writeIndex(size_t index, uint32_t entry);
+	uint32_t findOrAdd(int32_t value);
+	void release(uint32_t entry);
+	void repack(unsigned new_bits);
+	void collapse();
+
+	size_t size;
+	unsigned bits_per_index = 0;
+	uint64_t mask = 0;
+	vector<uint64_t> words;
+
+	vector<int32_t> palette;
+	vector<uint32_t> counts;
+	vector<uint32_t> free_entries;
+
+	bool use_lookup = false;
+	unordered_map<int32_t, uint32_t> lookup;
+};
+
+#endif // __BLOCK_STORAGE_HPP__
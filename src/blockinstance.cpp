@@ -1,10 +1,10 @@
 #include <cassert>
 #include "blockinstance.hpp"
+#include "gl_stats.hpp"
+#include "chunk_geometry.hpp"
 
-#define NELEMS(x) (sizeof(x) / sizeof(x[0]))
-
-BlockInstance::BlockInstance(Texture &texture, GLuint program_id, World &world) :
-	bits(BLOCK_WIDTH * BLOCK_DEPTH * BLOCK_HEIGHT, Block::Empty), texture(texture), program_id(program_id), world(world)
+BlockInstance::BlockInstance(Texture &texture, Program &program, World &world) :
+	bits(BLOCK_WIDTH * BLOCK_DEPTH * BLOCK_HEIGHT, Block::Empty), texture(texture), program(program), world(world)
 {
 	pos = glm::vec3(0, 0, 0);
 	rot = glm::vec3(0, 0, 0);
@@ -13,6 +13,7 @@ BlockInstance::BlockInstance(Texture &texture, GLuint program_id, World &world)
 
 BlockInstance::~BlockInstance()
 {
+	deleteBuffers();
 }
 
 void BlockInstance::setBit(int x, int y, int z, Block type)
@@ -21,7 +22,49 @@ void BlockInstance::setBit(int x, int y, int z, Block type)
 	assert(y >= 0 && y < BLOCK_HEIGHT);
 	assert(z >= 0 && z < BLOCK_DEPTH);
 
-	bits[(z * BLOCK_WIDTH * BLOCK_HEIGHT) + (y * BLOCK_WIDTH) + x] = type;
+	int i = index(x, y, z);
+	if (bits.get(i) != type)
+	{
+		bits.set(i, type);
+		dirty = true;
+		needs_mesh = true;
+
+		// Neighbours mesh their faces against the voxels along the border
+		if (x == 0)
+		{
+			markNeighbour(FaceLeft);
+		}
+		if (x == BLOCK_WIDTH - 1)
+		{
+			markNeighbour(FaceRight);
+		}
+		if (y == 0)
+		{
+			markNeighbour(FaceBottom);
+		}
+		if (y == BLOCK_HEIGHT - 1)
+		{
+			markNeighbour(FaceTop);
+		}
+		if (z == 0)
+		{
+			markNeighbour(FaceBack);
+		}
+		if (z == BLOCK_DEPTH - 1)
+		{
+			markNeighbour(FaceFront);
+		}
+	}
+}
+
+void BlockInstance::markNeighbour(Face face)
+{
+	// An empty neighbour has no faces to change
+	BlockInstance *neighbour = neighbours[face];
+	if (neighbour && !neighbour->isEmpty())
+	{
+		neighbour->needs_mesh = true;
+	}
 }
 
 void BlockInstance::resetBit(int x, int y, int z)
@@ -29,84 +72,610 @@ void BlockInstance::resetBit(int x, int y, int z)
 	setBit(x, y, z, Block::Empty);
 }
 
-void BlockInstance::addFace(Face face, int texsel, float xoffset, float yoffset, float zoffset)
+BlockInstance::Block BlockInstance::getBit(int x, int y, int z) const
 {
-	for (size_t i=0; i<NumVertices; i++)
+	// Coordinates one step outside of this block are looked up in the neighbouring block (if any)
+	if (x < 0)
+	{
+		return neighbours[FaceLeft] ? neighbours[FaceLeft]->getBit(x + BLOCK_WIDTH, y, z) : Block::Empty;
+	}
+	if (x >= BLOCK_WIDTH)
+	{
+		return neighbours[FaceRight] ? neighbours[FaceRight]->getBit(x - BLOCK_WIDTH, y, z) : Block::Empty;
+	}
+	if (y < 0)
+	{
+		return neighbours[FaceBottom] ? neighbours[FaceBottom]->getBit(x, y + BLOCK_HEIGHT, z) : Block::Empty;
+	}
+	if (y >= BLOCK_HEIGHT)
+	{
+		return neighbours[FaceTop] ? neighbours[FaceTop]->getBit(x, y - BLOCK_HEIGHT, z) : Block::Empty;
+	}
+	if (z < 0)
+	{
+		return neighbours[FaceBack] ? neighbours[FaceBack]->getBit(x, y, z + BLOCK_DEPTH) : Block::Empty;
+	}
+	if (z >= BLOCK_DEPTH)
 	{
-			m_vertices.push_back(vertices[face][i*3+0] + xoffset);
-			m_vertices.push_back(vertices[face][i*3+1] + yoffset);
-			m_vertices.push_back(vertices[face][i*3+2] + zoffset);
+		return neighbours[FaceFront] ? neighbours[FaceFront]->getBit(x, y, z - BLOCK_DEPTH) : Block::Empty;
+	}
+
+	return static_cast<Block>(bits.get(index(x, y, z)));
+}
+
+BlockInstance::Snapshot BlockInstance::snapshot()
+{
+	mesh_generation++;
+	needs_mesh = false;
+
+	Snapshot snapshot;
+	snapshot.uniform = bits.isUniform();
+	snapshot.uniform_type = static_cast<Block>(bits.uniformValue());
 
-			m_normals.push_back(normals[face][0]);
-			m_normals.push_back(normals[face][1]);
-			m_normals.push_back(normals[face][2]);
+	// Nothing to mesh so don't bother copying
+	if (snapshot.uniform && snapshot.uniform_type == Block::Empty)
+	{
+		return snapshot;
 	}
 
-	float texx_scale = 1.0f / 16.0f;
-	float texy_scale = 1.0f / 16.0f;
-	float texx = static_cast<float>(texsel % 16) * texx_scale;
-	float texy = static_cast<float>(texsel / 16) * texy_scale;
+	snapshot.voxels.assign(Snapshot::Width * Snapshot::Height * Snapshot::Depth, Block::Empty);
 
-	for (size_t i=0; i<NELEMS(textures); i+=2)
+	for (int z=-1; z<=BLOCK_DEPTH; z++)
 	{
-		m_tex_coords.push_back(textures[i] * texx_scale + texx);
-		m_tex_coords.push_back(1.0f - (textures[i+1] * texy_scale + texy));
+		for (int y=-1; y<=BLOCK_HEIGHT; y++)
+		{
+			for (int x=-1; x<=BLOCK_WIDTH; x++)
+			{
+				// Only voxels sharing a face with this block are needed, so skip edges and corners
+				int outside = (x < 0 || x >= BLOCK_WIDTH) + (y < 0 || y >= BLOCK_HEIGHT) + (z < 0 || z >= BLOCK_DEPTH);
+				if (outside <= 1)
+				{
+					snapshot.at(x, y, z) = getBit(x, y, z);
+				}
+			}
+		}
 	}
+
+	return snapshot;
 }
 
-void BlockInstance::generateBlock()
+BlockInstance::Snapshot BlockInstance::downsample(const Snapshot &snapshot, int level)
 {
-	// Clear arrays and buffers
-	glDeleteVertexArrays(1, &vertex_array_id);
-	glDeleteBuffers(3, buffers);
+	const int scale = 1 << level;
+	const int fine_dims[3] = { BLOCK_WIDTH, BLOCK_HEIGHT, BLOCK_DEPTH };
+	const int dims[3] = { BLOCK_WIDTH >> level, BLOCK_HEIGHT >> level, BLOCK_DEPTH >> level };
+
+	// Same layout as the full snapshot, only the corner of it is used
+	Snapshot coarse;
+	coarse.voxels.assign(Snapshot::Width * Snapshot::Height * Snapshot::Depth, Block::Empty);
+
+	// A cell is solid when any of its voxels are, so the coarse block always covers the detailed one and
+	// no gaps open up against neighbours drawn at other levels. Its material is the most common one, with
+	// voxels open to the air counting double so that the surface wins over whatever is buried beneath it.
+	for (int cz=0; cz<dims[2]; cz++)
+	{
+		for (int cy=0; cy<dims[1]; cy++)
+		{
+			for (int cx=0; cx<dims[0]; cx++)
+			{
+				int counts[MaxBlocks] = { 0 };
+				for (int z=cz*scale; z<(cz+1)*scale; z++)
+				{
+					for (int y=cy*scale; y<(cy+1)*scale; y++)
+					{
+						for (int x=cx*scale; x<(cx+1)*scale; x++)
+						{
+							Block blockType = snapshot.at(x, y, z);
+							if (blockType == Block::Empty)
+							{
+								continue;
+							}
+
+							bool exposed = false;
+							for (int face=0; face<MaxFaces && !exposed; face++)
+							{
+								exposed = !snapshot.isSolid(x + faceOffsets[face][0], y + faceOffsets[face][1], z + faceOffsets[face][2]);
+							}
+							counts[blockType] += exposed ? 2 : 1;
+						}
+					}
+				}
 
-	m_vertices.clear();
-	m_tex_coords.clear();
-	m_normals.clear();
+				int best = Block::Empty;
+				for (int type=0; type<MaxBlocks; type++)
+				{
+					if (counts[type] > 0 && (best == Block::Empty || counts[type] > counts[best]))
+					{
+						best = type;
+					}
+				}
+				coarse.at(cx, cy, cz) = static_cast<Block>(best);
+			}
+		}
+	}
 
-	int offset = 0;
-	for (int z=0; z<BLOCK_DEPTH; z++)
+	// A border cell only counts as solid when the neighbour's voxels against the whole of it are, as only
+	// then is a face there hidden whichever level the neighbour is drawn at
+	for (int face=0; face<MaxFaces; face++)
 	{
-		for (int y=0; y<BLOCK_HEIGHT; y++)
+		int u_axis = faceAxes[face][0];
+		int v_axis = faceAxes[face][1];
+		int n_axis = 3 - u_axis - v_axis;
+		bool ahead = faceOffsets[face][n_axis] > 0;
+
+		int fine[3];
+		int cell[3];
+		fine[n_axis] = ahead ? fine_dims[n_axis] : -1;
+		cell[n_axis] = ahead ? dims[n_axis] : -1;
+
+		for (int cv=0; cv<dims[v_axis]; cv++)
 		{
-			for (int x=0; x<BLOCK_WIDTH; x++)
+			for (int cu=0; cu<dims[u_axis]; cu++)
 			{
-				Block blockType = bits[offset];
+				bool covered = true;
+				for (int v=cv*scale; v<(cv+1)*scale && covered; v++)
+				{
+					for (int u=cu*scale; u<(cu+1)*scale && covered; u++)
+					{
+						fine[u_axis] = u;
+						fine[v_axis] = v;
+						covered = snapshot.isSolid(fine[0], fine[1], fine[2]);
+					}
+				}
 
-				if (blockType != Block::Empty)
+				if (covered)
 				{
-					float xoffset = static_cast<float>(x);
-					float yoffset = static_cast<float>(y);
-					float zoffset = static_cast<float>(z);
+					// Only ever tested for being solid
+					cell[u_axis] = cu;
+					cell[v_axis] = cv;
+					coarse.at(cell[0], cell[1], cell[2]) = Block::Stone;
+				}
+			}
+		}
+	}
+
+	return coarse;
+}
+
+void BlockInstance::addFace(Face face, int layer, int x, int y, int z, int width, int height, Mesh &mesh, int scale)
+{
+	// Size of the face along each axis in voxels; the normal axis stays at one cell
+	int size[3] = { scale, scale, scale };
+	size[faceAxes[face][0]] = width * scale;
+	size[faceAxes[face][1]] = height * scale;
+
+	int offset[3] = { x * scale, y * scale, z * scale };
+
+	for (size_t i=0; i<NumVertices; i++)
+	{
+		// Stretch the unit face from its -0.5 corner to cover the merged voxels
+		int corner[3];
+		for (size_t j=0; j<3; j++)
+		{
+			corner[j] = static_cast<int>(vertices[face][i*3+j] + 0.5f) * size[j] + offset[j];
+		}
+
+		glm::vec3 point(corner[0] - 0.5f, corner[1] - 0.5f, corner[2] - 0.5f);
+		if (mesh.num_vertices == 0 && i == 0)
+		{
+			mesh.bounds = AABB(point, point);
+		}
+		mesh.bounds.min = glm::min(mesh.bounds.min, point);
+		mesh.bounds.max = glm::max(mesh.bounds.max, point);
+
+		if (width * height * scale * scale >= MinOccluderArea)
+		{
+			mesh.occluders.push_back(point);
+		}
+
+		int tile_u = static_cast<int>(textures[i*2+0]) * size[faceAxes[face][0]];
+		int tile_v = static_cast<int>(textures[i*2+1]) * size[faceAxes[face][1]];
+
+		if (mesh.format == FormatPacked)
+		{
+			PackedVertex vertex;
+			vertex.geometry = corner[0] | (corner[1] << 5) | (corner[2] << 10) | (face << 15) | (tile_u << 18) | (tile_v << 23);
+			vertex.material = layer;
+			mesh.packed.push_back(vertex);
+			continue;
+		}
+
+		for (size_t j=0; j<3; j++)
+		{
+			mesh.vertices.push_back(static_cast<float>(corner[j]) - 0.5f);
+		}
+
+		mesh.normals.push_back(normals[face][0]);
+		mesh.normals.push_back(normals[face][1]);
+		mesh.normals.push_back(normals[face][2]);
+
+		mesh.tex_coords.push_back(static_cast<float>(tile_u));
+		mesh.tex_coords.push_back(static_cast<float>(tile_v));
+
+		mesh.layers.push_back(static_cast<float>(layer));
+	}
+
+	mesh.num_vertices += NumVertices;
+}
 
+void BlockInstance::generateFaces(const Snapshot &snapshot, MeshMode mode, Mesh &mesh, int level)
+{
+	for (int z=0; z<(BLOCK_DEPTH >> level); z++)
+	{
+		for (int y=0; y<(BLOCK_HEIGHT >> level); y++)
+		{
+			for (int x=0; x<(BLOCK_WIDTH >> level); x++)
+			{
+				Block blockType = snapshot.at(x, y, z);
+
+				if (blockType != Block::Empty)
+				{
 					// Set up arrays
-					addFace(FaceTop, blockIndices[blockType][0], xoffset, yoffset, zoffset);
-					addFace(FaceBottom, blockIndices[blockType][1], xoffset, yoffset, zoffset);
-					addFace(FaceBack, blockIndices[blockType][2], xoffset, yoffset, zoffset);
-					addFace(FaceFront, blockIndices[blockType][3], xoffset, yoffset, zoffset);
-					addFace(FaceLeft, blockIndices[blockType][4], xoffset, yoffset, zoffset);
-					addFace(FaceRight, blockIndices[blockType][5], xoffset, yoffset, zoffset);
+					for (int face=0; face<MaxFaces; face++)
+					{
+						mesh.faces_total++;
+
+						// A face against a solid voxel can never be seen
+						if (mode == MeshCulled &&
+							snapshot.isSolid(x + faceOffsets[face][0], y + faceOffsets[face][1], z + faceOffsets[face][2]))
+						{
+							continue;
+						}
+
+						addFace(static_cast<Face>(face), blockIndices[blockType][face], x, y, z, 1, 1, mesh, 1 << level);
+						mesh.faces_emitted++;
+					}
 				}
+			}
+		}
+	}
+}
+
+void BlockInstance::generateGreedy(const Snapshot &snapshot, Mesh &mesh, int level)
+{
+	const int dims[3] = { BLOCK_WIDTH >> level, BLOCK_HEIGHT >> level, BLOCK_DEPTH >> level };
+
+	for (int face=0; face<MaxFaces; face++)
+	{
+		int u_axis = faceAxes[face][0];
+		int v_axis = faceAxes[face][1];
+		int n_axis = 3 - u_axis - v_axis;
+
+		int u_size = dims[u_axis];
+		int v_size = dims[v_axis];
+
+		// Material layer plus one for each visible face in a slice, zero where there is no face
+		vector<int> mask(u_size * v_size);
 
-				offset++;
+		for (int n=0; n<dims[n_axis]; n++)
+		{
+			int pos[3];
+			pos[n_axis] = n;
+
+			for (int v=0; v<v_size; v++)
+			{
+				for (int u=0; u<u_size; u++)
+				{
+					pos[u_axis] = u;
+					pos[v_axis] = v;
+
+					int &cell = mask[v * u_size + u];
+					cell = 0;
+
+					Block blockType = snapshot.at(pos[0], pos[1], pos[2]);
+					if (blockType == Block::Empty)
+					{
+						continue;
+					}
+
+					mesh.faces_total++;
+
+					if (!snapshot.isSolid(pos[0] + faceOffsets[face][0], pos[1] + faceOffsets[face][1], pos[2] + faceOffsets[face][2]))
+					{
+						cell = blockIndices[blockType][face] + 1;
+					}
+				}
+			}
+
+			// Grow rectangles of matching faces, first along u and then along v
+			for (int v=0; v<v_size; v++)
+			{
+				for (int u=0; u<u_size; )
+				{
+					int cell = mask[v * u_size + u];
+					if (cell == 0)
+					{
+						u++;
+						continue;
+					}
+
+					int width = 1;
+					while (u + width < u_size && mask[v * u_size + u + width] == cell)
+					{
+						width++;
+					}
+
+					int height = 1;
+					for (bool done = false; v + height < v_size && !done; )
+					{
+						for (int k=0; k<width; k++)
+						{
+							if (mask[(v + height) * u_size + u + k] != cell)
+							{
+								done = true;
+								break;
+							}
+						}
+
+						if (!done)
+						{
+							height++;
+						}
+					}
+
+					pos[u_axis] = u;
+					pos[v_axis] = v;
+					addFace(static_cast<Face>(face), cell - 1, pos[0], pos[1], pos[2], width, height, mesh, 1 << level);
+					mesh.faces_emitted++;
+
+					for (int j=0; j<height; j++)
+					{
+						for (int k=0; k<width; k++)
+						{
+							mask[(v + j) * u_size + u + k] = 0;
+						}
+					}
+
+					u += width;
+				}
 			}
 		}
 	}
+}
 
-	// Create OpenGL buffers
-	glGenVertexArrays(1, &vertex_array_id);
-	glBindVertexArray(vertex_array_id);
+void BlockInstance::buildMesh(const Snapshot &snapshot, MeshMode mode, VertexFormat format, Mesh &mesh, int level)
+{
+	mesh = Mesh();
+	mesh.format = format;
 
-	glGenBuffers(3, buffers);
+	// Uniform blocks are either empty or solid throughout, in which case only faces on the outside
+	// of the block can be visible and there are none if all of its neighbours are solid too
+	if (snapshot.uniform)
+	{
+		if (snapshot.uniform_type == Block::Empty)
+		{
+			return;
+		}
 
-	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), m_vertices.data(), GL_STATIC_DRAW);
+		bool enclosed = true;
+		for (int z=0; z<BLOCK_DEPTH && enclosed; z++)
+		{
+			for (int y=0; y<BLOCK_HEIGHT && enclosed; y++)
+			{
+				enclosed = snapshot.isSolid(-1, y, z) && snapshot.isSolid(BLOCK_WIDTH, y, z);
+			}
+		}
+		for (int z=0; z<BLOCK_DEPTH && enclosed; z++)
+		{
+			for (int x=0; x<BLOCK_WIDTH && enclosed; x++)
+			{
+				enclosed = snapshot.isSolid(x, -1, z) && snapshot.isSolid(x, BLOCK_HEIGHT, z);
+			}
+		}
+		for (int y=0; y<BLOCK_HEIGHT && enclosed; y++)
+		{
+			for (int x=0; x<BLOCK_WIDTH && enclosed; x++)
+			{
+				enclosed = snapshot.isSolid(x, y, -1) && snapshot.isSolid(x, y, BLOCK_DEPTH);
+			}
+		}
 
-	glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
-	glBufferData(GL_ARRAY_BUFFER, m_tex_coords.size() * sizeof(float), m_tex_coords.data(), GL_STATIC_DRAW);
+		if (enclosed && mode != MeshNaive)
+		{
+			mesh.faces_total = BLOCK_WIDTH * BLOCK_HEIGHT * BLOCK_DEPTH * MaxFaces;
+			return;
+		}
+	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
-	glBufferData(GL_ARRAY_BUFFER, m_normals.size() * sizeof(float), m_normals.data(), GL_STATIC_DRAW);
+	// Coarser levels are meshed from a downsampled copy, with the quads scaled back up to voxel units
+	Snapshot coarse;
+	if (level > 0)
+	{
+		coarse = downsample(snapshot, level);
+	}
+	const Snapshot &source = level > 0 ? coarse : snapshot;
+
+	if (mode == MeshGreedy)
+	{
+		generateGreedy(source, mesh, level);
+	}
+	else
+	{
+		generateFaces(source, mode, mesh, level);
+	}
+}
+
+void BlockInstance::generateBlock()
+{
+	Snapshot current = snapshot();
+	for (int level=0; level<lod_levels; level++)
+	{
+		Mesh mesh;
+		buildMesh(current, mesh_mode, vertex_format, mesh, level);
+		uploadMesh(mesh, level);
+	}
+}
+
+size_t BlockInstance::numVertices() const
+{
+	size_t total = 0;
+	for (const auto &level : levels)
+	{
+		total += level.num_vertices;
+	}
+	return total;
+}
+
+size_t BlockInstance::meshBytes() const
+{
+	size_t total = 0;
+	for (const auto &level : levels)
+	{
+		total += level.num_vertices * (level.format == FormatPacked ? sizeof(PackedVertex) : FloatVertexSize);
+	}
+	return total;
+}
+
+void BlockInstance::deleteBuffers()
+{
+	for (int level=0; level<MaxLods; level++)
+	{
+		deleteBuffers(level);
+	}
+}
+
+void BlockInstance::deleteBuffers(int level)
+{
+	Level &target = levels[level];
+	if (target.geometry_slot >= 0)
+	{
+		geometry->release(target.geometry_slot);
+		target.geometry_slot = -1;
+	}
+
+	if (target.vertex_array_id == 0)
+	{
+		return;
+	}
+
+	glDeleteVertexArrays(1, &target.vertex_array_id);
+	glDeleteBuffers(4, target.buffers);
+
+	target.vertex_array_id = 0;
+	target.vertex_capacity = 0;
+	for (auto &buffer : target.buffers)
+	{
+		buffer = 0;
+	}
+}
+
+// Write a buffer's data, reallocating it only when it has to grow
+static void fillBuffer(GLuint buffer, size_t bytes, const void *data, bool fits)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (fits)
+	{
+		GL_UPLOAD(bytes, glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data));
+	}
+	else
+	{
+		GL_UPLOAD(bytes, glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW));
+	}
+}
+
+void BlockInstance::uploadMesh(const Mesh &mesh, int level)
+{
+	Level &target = levels[level];
+
+	// The previous mesh is only replaced now so that it can be drawn until the new one is ready. A
+	// remesh goes into the GL objects or shared buffer slot the old mesh was using.
+	bool shared = geometry && mesh.format == FormatPacked;
+	bool reuse = mesh.num_vertices > 0 && mesh.format == target.format &&
+		(shared ? target.geometry_slot >= 0 : target.vertex_array_id != 0);
+	if (!reuse)
+	{
+		deleteBuffers(level);
+	}
+
+	target.format = mesh.format;
+	target.num_vertices = mesh.num_vertices;
+
+	// Culling goes by the full detail mesh, widened to take in the coarser ones which can stick out of it
+	if (level == 0)
+	{
+		faces_total = mesh.faces_total;
+		faces_emitted = mesh.faces_emitted;
+		mesh_bounds = mesh.bounds;
+		mesh_occluders = mesh.occluders;
+	}
+	else if (mesh.num_vertices > 0)
+	{
+		mesh_bounds.min = glm::min(mesh_bounds.min, mesh.bounds.min);
+		mesh_bounds.max = glm::max(mesh_bounds.max, mesh.bounds.max);
+	}
+
+	// Nothing to draw so don't hold on to any GL objects
+	if (target.num_vertices == 0)
+	{
+		return;
+	}
+
+	if (shared)
+	{
+		if (reuse)
+		{
+			geometry->update(target.geometry_slot, mesh.packed);
+		}
+		else
+		{
+			target.geometry_slot = geometry->allocate(mesh.packed, pos);
+		}
+		return;
+	}
+
+	if (!reuse)
+	{
+		createBuffers(level);
+	}
+
+	// Element buffer binding is part of the vertex array state
+	glBindVertexArray(target.vertex_array_id);
+	QuadIndices::bind(target.num_vertices / NumVertices);
+
+	bool fits = target.num_vertices <= target.vertex_capacity;
+	target.vertex_capacity = max(target.vertex_capacity, target.num_vertices);
+
+	GLuint *buffers = target.buffers;
+	if (mesh.format == FormatPacked)
+	{
+		fillBuffer(buffers[0], mesh.packed.size() * sizeof(PackedVertex), mesh.packed.data(), fits);
+		return;
+	}
+
+	fillBuffer(buffers[0], mesh.vertices.size() * sizeof(float), mesh.vertices.data(), fits);
+	fillBuffer(buffers[1], mesh.tex_coords.size() * sizeof(float), mesh.tex_coords.data(), fits);
+	fillBuffer(buffers[2], mesh.normals.size() * sizeof(float), mesh.normals.data(), fits);
+	fillBuffer(buffers[3], mesh.layers.size() * sizeof(float), mesh.layers.data(), fits);
+}
+
+void BlockInstance::createBuffers(int level)
+{
+	// Buffers start empty and are sized by the first upload
+	Level &target = levels[level];
+	target.vertex_capacity = 0;
+
+	glGenVertexArrays(1, &target.vertex_array_id);
+	glBindVertexArray(target.vertex_array_id);
+
+	GLuint *buffers = target.buffers;
+	if (target.format == FormatPacked)
+	{
+		glGenBuffers(1, buffers);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+
+		// Integer attribute that the shader unpacks
+		glEnableVertexAttribArray(4);
+		glVertexAttribIPointer(
+			4,
+			2,
+			GL_UNSIGNED_INT,
+			sizeof(PackedVertex),
+			(void*)0
+			);
+		return;
+	}
+
+	glGenBuffers(4, buffers);
 
 	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
@@ -119,14 +688,14 @@ void BlockInstance::generateBlock()
 		(void*)0            // array buffer offset
 		);
 
-	// Second attribute buffer: texture coords
+	// Second attribute buffer: texture coords (in tiles, so not normalized)
 	glEnableVertexAttribArray(1);
 	glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
 	glVertexAttribPointer(
 		1,
 		2,
 		GL_FLOAT,
-		GL_TRUE,
+		GL_FALSE,
 		0,
 		(void*)0
 		);
@@ -142,41 +711,48 @@ void BlockInstance::generateBlock()
 		0,
 		(void*)0
 		);
+
+	// Fourth attribute buffer: material layer
+	glEnableVertexAttribArray(3);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[3]);
+	glVertexAttribPointer(
+		3,
+		1,
+		GL_FLOAT,
+		GL_FALSE,
+		0,
+		(void*)0
+		);
 }
 
-void BlockInstance::setUniforms()
+glm::mat4 BlockInstance::modelMatrix() const
 {
 	glm::mat4 model = glm::mat4(1);
-	model = glm::translate(pos) *
+	return glm::translate(pos) *
 		glm::rotate(model, rot.x, glm::vec3(1.0, 0.0, 0.0)) *
 		glm::rotate(model, rot.y, glm::vec3(0.0, 1.0, 0.0)) *
 		glm::rotate(model, rot.z, glm::vec3(0.0, 0.0, 1.0)) *
 		glm::scale(model, sca);
-	
-	glm::mat4 mvp = world.camera().projection() * world.camera().view() * model;
-
-	glUseProgram(program_id);
-
-	world.camera().setUniform(program_id, "Camera_Pos");
-	texture.setUniform(program_id, "Tex_Cube");
-	world.light().setUniforms(program_id, "Light_Pos", "Light_Col");
-
-	GLuint mvp_id = glGetUniformLocation(program_id, "MVP");
-	glUniformMatrix4fv(mvp_id, 1, GL_FALSE, &mvp[0][0]);
-
-	GLuint m_id = glGetUniformLocation(program_id, "M");
-	glUniformMatrix4fv(m_id, 1, GL_FALSE, &model[0][0]);
-
-	GLuint v_id = glGetUniformLocation(program_id, "V");
-	glUniformMatrix4fv(v_id, 1, GL_FALSE, &world.camera().view()[0][0]);
 }
 
-void BlockInstance::render()
+void BlockInstance::submit(RenderQueue &queue, float depth)
 {
-	texture.bind();
-	glBindVertexArray(vertex_array_id);
+	const Level &current = levels[lod];
+	if (current.vertex_array_id == 0)
+	{
+		return;
+	}
 
-	glDrawArrays(GL_TRIANGLES, 0, m_vertices.size() / 3);
-	glBindVertexArray(0);
-}
+	// Camera and light come from the frame uniform block
+	DrawPacket packet;
+	packet.program = &program;
+	packet.texture = &texture;
+	packet.vertex_array_id = current.vertex_array_id;
+	packet.flags = DrawPacket::FlagTiledUV | (current.format == FormatPacked ? DrawPacket::FlagPackedVertex : 0);
+	packet.model = modelMatrix();
+
+	GLsizei count = static_cast<GLsizei>(QuadIndices::numIndices(current.num_vertices / NumVertices));
+	packet.draw = [count]() { GL_DRAW(count / 3, glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)0)); };
 
+	queue.submit(move(packet), depth);
+}
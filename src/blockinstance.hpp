@@ -2,6 +2,7 @@
 #define __BLOCK_INSTANCE_HPP__
 
 #include <vector>
+#include <cstdint>
 
 // Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
 #include <GL/glew.h>
@@ -16,7 +17,12 @@
 #include <glm/gtx/transform.hpp>
 
 #include "texture.hpp"
+#include "program.hpp"
 #include "world.hpp"
+#include "quad_indices.hpp"
+#include "block_storage.hpp"
+#include "frustum.hpp"
+#include "render_queue.hpp"
 
 constexpr int BLOCK_WIDTH = 16;
 constexpr int BLOCK_DEPTH = 16;
@@ -24,12 +30,18 @@ constexpr int BLOCK_HEIGHT = 16;
 
 using namespace std;
 
+class ChunkGeometry;
+
 class BlockInstance
 {
 public:
-	BlockInstance(Texture &texture, GLuint program_id, World &world);
+	BlockInstance(Texture &texture, Program &program, World &world);
 	virtual ~BlockInstance();
 
+	// Blocks own GL buffers and are pointed to by their neighbours, so they can't be copied
+	BlockInstance(const BlockInstance &) = delete;
+	BlockInstance &operator=(const BlockInstance &) = delete;
+
 	enum Block
 	{
 		Empty = -1,
@@ -39,18 +51,10 @@ public:
 		MaxBlocks = 3
 	};
 
-	void setBit(int x, int y, int z, Block type);
-	void resetBit(int x, int y, int z);
-	void generateBlock();
-
-	void setUniforms();
-	void render();
+	// Materials are the layers of a texture array, each cut from this cell of the 16x16 atlas.
+	// New materials are added to the end.
+	inline constexpr static int materialCells[] = { 0, 1, 2, 16 };
 
-	glm::vec3 &position() { return pos; }
-	glm::vec3 &rotation() { return rot; }
-	glm::vec3 &scale() { return sca; }
-
-private:
 	enum Face
 	{
 		FaceTop = 0,
@@ -62,26 +66,211 @@ private:
 		MaxFaces = 6
 	};
 
-	void addFace(Face face, int texsel, float xoffset, float yoffset, float zoffset);
+	enum MeshMode
+	{
+		MeshNaive = 0,  // Every face of every solid voxel
+		MeshCulled = 1, // Skip faces that touch a solid voxel, including across chunk borders
+		MeshGreedy = 2  // As culled but merge coplanar faces of the same texture into larger quads
+	};
+
+	enum VertexFormat
+	{
+		FormatFloat = 0, // Separate float buffers for position, texture, normal and material layer (36 bytes)
+		FormatPacked = 1 // A single interleaved buffer of PackedVertex (8 bytes)
+	};
+
+	// Packed vertex layout, decoded in the vertex shader:
+	//   geometry bits 0-14  - x, y and z of the voxel corner (0 to 16, 5 bits each)
+	//   geometry bits 15-17 - face normal index
+	//   geometry bits 18-27 - u and v texture coordinate in tiles (0 to 16, 5 bits each)
+	//   material bits 0-15  - layer of the block material texture array
+	//   material bits 16-31 - slot of the block's origin when drawn from ChunkGeometry
+	struct PackedVertex
+	{
+		uint32_t geometry;
+		uint32_t material;
+	};
+
+	static constexpr size_t FloatVertexSize = 9 * sizeof(float);
+
+	// Levels of detail. Level n merges 2^n voxels along each axis into one, so level 3 is a 2x2x2 block.
+	static constexpr int MaxLods = 4;
+
+	// Copy of a block's voxels plus a one voxel border from its neighbours. Meshing only reads
+	// from this so it can run on another thread while the block carries on being edited.
+	struct Snapshot
+	{
+		static constexpr int Width = BLOCK_WIDTH + 2;
+		static constexpr int Height = BLOCK_HEIGHT + 2;
+		static constexpr int Depth = BLOCK_DEPTH + 2;
+
+		vector<Block> voxels;
+
+		// Set when the block itself holds a single type, in which case voxels is left empty if that is Empty
+		bool uniform = false;
+		Block uniform_type = Block::Empty;
+
+		// Coordinates run from -1 to the block size inclusive
+		Block &at(int x, int y, int z) { return voxels[((z + 1) * Height + (y + 1)) * Width + (x + 1)]; }
+		Block at(int x, int y, int z) const { return voxels[((z + 1) * Height + (y + 1)) * Width + (x + 1)]; }
+		bool isSolid(int x, int y, int z) const { return at(x, y, z) != Block::Empty; }
+	};
+
+	// CPU side mesh data ready to be handed to uploadMesh
+	struct Mesh
+	{
+		VertexFormat format = FormatPacked;
+		vector<float> vertices;
+		vector<float> tex_coords;
+		vector<float> normals;
+		vector<float> layers;
+		vector<PackedVertex> packed;
+		size_t num_vertices = 0;
+		size_t faces_total = 0;
+		size_t faces_emitted = 0;
+		AABB bounds; // Around the emitted faces in model space
+		vector<glm::vec3> occluders; // Corners of the larger faces in model space, four per face
+	};
+
+	// Faces covering fewer voxels than this aren't worth drawing into the occlusion buffer
+	static constexpr int MinOccluderArea = 4;
+
+	void setBit(int x, int y, int z, Block type);
+	void resetBit(int x, int y, int z);
+	Block getBit(int x, int y, int z) const;
+	bool isSolid(int x, int y, int z) const { return getBit(x, y, z) != Block::Empty; }
+
+	void setNeighbour(Face face, BlockInstance *neighbour) { neighbours[face] = neighbour; }
+	void setMeshMode(MeshMode mode) { mesh_mode = mode; }
+	void setVertexFormat(VertexFormat format) { vertex_format = format; }
+
+	// Number of levels of detail meshed for the block, from 1 (full detail only) to MaxLods
+	void setLodLevels(int levels) { lod_levels = glm::clamp(levels, 1, MaxLods); }
+	int lodLevels() const { return lod_levels; }
+
+	// Level drawn from now on, picked each frame from the distance to the camera
+	void setLod(int level) { lod = glm::clamp(level, 0, lod_levels - 1); }
+	int currentLod() const { return lod; }
+
+	// Put packed meshes in a shared buffer rather than a vertex array of their own. The shared buffer
+	// takes the block's position when the mesh is uploaded, and has to outlive the block.
+	void setGeometry(ChunkGeometry *shared) { geometry = shared; }
+	MeshMode meshMode() const { return mesh_mode; }
+	VertexFormat vertexFormat() const { return vertex_format; }
+
+	// Mesh the block and upload it straight away
+	void generateBlock();
+
+	// The steps of generateBlock for callers that mesh elsewhere. Only buildMesh may be called off the
+	// render thread. Each snapshot bumps the mesh generation so that older meshes can be spotted.
+	// Every level of detail is built from the same snapshot and uploaded together.
+	Snapshot snapshot();
+	static void buildMesh(const Snapshot &snapshot, MeshMode mode, VertexFormat format, Mesh &mesh, int level = 0);
+	void uploadMesh(const Mesh &mesh, int level = 0);
+	unsigned meshGeneration() const { return mesh_generation; }
+	bool hasMesh() const { return levels[0].vertex_array_id != 0 || levels[0].geometry_slot >= 0; } // False until meshed or when there is nothing to draw
 
-	vector<Block> bits;
+	// Slot of the current level in the shared ChunkGeometry, -1 when the mesh has its own vertex array
+	// (or there is none). Blocks in a shared buffer are drawn by adding the slot to it instead of calling submit().
+	int geometrySlot() const { return levels[lod].geometry_slot; }
+
+	// Face counts from the last uploaded full detail mesh: all faces of solid voxels and those actually emitted
+	size_t numFacesTotal() const { return faces_total; }
+	size_t numFaces() const { return faces_emitted; }
+
+	// Faces drawn at the current level of detail
+	size_t numLodFaces() const { return levels[lod].num_vertices / NumVertices; }
+
+	// Vertices in the uploaded meshes of every level and the bytes they take up on the GPU
+	size_t numVertices() const;
+	size_t meshBytes() const;
+
+	// Bytes used to store the voxels of the block
+	size_t memoryUsage() const { return bits.memoryUsage(); }
+	bool isUniform() const { return bits.isUniform(); }
+	bool isEmpty() const { return bits.isUniform() && bits.uniformValue() == Block::Empty; }
+
+	// Set when setBit changes a voxel, so that edited blocks can be written back to disk
+	bool isDirty() const { return dirty; }
+	void clearDirty() { dirty = false; }
+
+	// Set when the mesh is out of date: by setBit, on the neighbours too when a voxel on the border
+	// changes, and by markForMesh. Cleared by snapshot(), so however many voxels change a block
+	// is only remeshed once by whoever collects the marked blocks.
+	bool needsMesh() const { return needs_mesh; }
+	void markForMesh() { needs_mesh = true; }
+
+	// Centre of the block in world space
+	glm::vec3 centre() const { return pos + glm::vec3(BLOCK_WIDTH - 1, BLOCK_HEIGHT - 1, BLOCK_DEPTH - 1) * 0.5f; }
+
+	// World space box around the faces of the uploaded mesh, for culling
+	AABB bounds() const { return mesh_bounds.transform(modelMatrix()); }
+
+	// Large faces of the uploaded mesh in model space for the occlusion buffer
+	const vector<glm::vec3> &occluders() const { return mesh_occluders; }
+	glm::mat4 modelMatrix() const;
+
+	// Queue a draw of a mesh with its own vertex array, depth being the distance from the camera
+	void submit(RenderQueue &queue, float depth);
+
+	glm::vec3 &position() { return pos; }
+	glm::vec3 &rotation() { return rot; }
+	glm::vec3 &scale() { return sca; }
+
+private:
+	static int index(int x, int y, int z) { return (z * BLOCK_WIDTH * BLOCK_HEIGHT) + (y * BLOCK_WIDTH) + x; }
+
+	static Snapshot downsample(const Snapshot &snapshot, int level);
+	static void generateFaces(const Snapshot &snapshot, MeshMode mode, Mesh &mesh, int level);
+	static void generateGreedy(const Snapshot &snapshot, Mesh &mesh, int level);
+	static void addFace(Face face, int layer, int x, int y, int z, int width, int height, Mesh &mesh, int scale = 1);
+	void markNeighbour(Face face);
+	void createBuffers(int level);
+	void deleteBuffers();
+	void deleteBuffers(int level);
+
+	BlockStorage bits;
 
 	glm::vec3 pos;
 	glm::vec3 rot;
 	glm::vec3 sca;
 
 	Texture &texture;
-	GLuint program_id;
+	Program &program;
 	World &world;
 
-	vector<float> m_vertices;
-	vector<float> m_tex_coords;
-	vector<float> m_normals;
+	BlockInstance *neighbours[MaxFaces] = {nullptr};
+	MeshMode mesh_mode = MeshGreedy;
+	VertexFormat vertex_format = FormatPacked;
+	unsigned mesh_generation = 0;
+	bool dirty = false;
+	bool needs_mesh = false;
+	int lod_levels = 1;
+	int lod = 0;
+
+	// Details of the uploaded full detail mesh. The coarser levels only widen the bounds.
+	size_t faces_total = 0;
+	size_t faces_emitted = 0;
+	AABB mesh_bounds;
+	vector<glm::vec3> mesh_occluders;
+
+	// GL objects of the mesh at each level of detail. They are kept when the block is remeshed, with
+	// the buffers only reallocated when a mesh outgrows them.
+	struct Level
+	{
+		VertexFormat format = FormatPacked;
+		size_t num_vertices = 0;
+		size_t vertex_capacity = 0;
+		GLuint vertex_array_id = 0;
+		GLuint buffers[4] = {0};
+		int geometry_slot = -1;
+	};
+	Level levels[MaxLods];
 
-	GLuint vertex_array_id = 0;
-	GLuint buffers[3] = {0};
+	ChunkGeometry *geometry = nullptr;
 
-	static constexpr int NumVertices = 6;
+	// Each face is a quad drawn through the shared QuadIndices buffer
+	static constexpr int NumVertices = QuadIndices::VerticesPerQuad;
 
 	inline static constexpr float vertices[MaxFaces][NumVertices * 3] = {
 		// Top face
@@ -89,8 +278,6 @@ private:
 			-0.5,  0.5, -0.5,
 			-0.5,  0.5,  0.5,
 			0.5,  0.5, -0.5,
-			0.5,  0.5, -0.5,
-			-0.5,  0.5,  0.5,
 			0.5,  0.5,  0.5
 		},
 		// Bottom face
@@ -98,8 +285,6 @@ private:
 			-0.5, -0.5,  0.5,
 			-0.5, -0.5, -0.5,
 			0.5, -0.5,  0.5,
-			0.5, -0.5,  0.5,
-			-0.5, -0.5, -0.5,
 			0.5, -0.5, -0.5
 		},
 		// Back face
@@ -107,8 +292,6 @@ private:
 			0.5,  0.5, -0.5,
 			0.5, -0.5, -0.5,
 			-0.5,  0.5, -0.5,
-			-0.5,  0.5, -0.5,
-			0.5, -0.5, -0.5,
 			-0.5, -0.5, -0.5
 		},
 		// Front face
@@ -116,17 +299,13 @@ private:
 			-0.5,  0.5,  0.5,
 			-0.5, -0.5,  0.5,
 			0.5,  0.5,  0.5,
-			0.5,  0.5,  0.5,
-			-0.5, -0.5,  0.5,
-			0.5, -0.5,  0.5,
+			0.5, -0.5,  0.5
 		},
 		// Left face
 		{
 			-0.5,  0.5, -0.5,
 			-0.5, -0.5, -0.5,
 			-0.5,  0.5,  0.5,
-			-0.5,  0.5,  0.5,
-			-0.5, -0.5, -0.5,
 			-0.5, -0.5,  0.5
 		},
 		// Right face
@@ -134,12 +313,30 @@ private:
 			0.5,  0.5,  0.5,
 			0.5, -0.5,  0.5,
 			0.5,  0.5, -0.5,
-			0.5,  0.5, -0.5,
-			0.5, -0.5,  0.5,
 			0.5, -0.5, -0.5
 		}
 	};
 
+	// Offset to the voxel that each face touches
+	inline constexpr static int faceOffsets[MaxFaces][3] = {
+		{ 0, 1, 0 },  // Top
+		{ 0, -1, 0 }, // Bottom
+		{ 0, 0, -1 }, // Back
+		{ 0, 0, 1 },  // Front
+		{ -1, 0, 0 }, // Left
+		{ 1, 0, 0 }   // Right
+	};
+
+	// The axes that a face's texture u and v coordinates run along
+	inline constexpr static int faceAxes[MaxFaces][2] = {
+		{ 0, 2 }, // Top
+		{ 0, 2 }, // Bottom
+		{ 0, 1 }, // Back
+		{ 0, 1 }, // Front
+		{ 2, 1 }, // Left
+		{ 2, 1 }  // Right
+	};
+
 	inline constexpr static float normals[MaxFaces][3] = {
 		// Point up
 		{ 0.0, 1.0, 0.0 },
@@ -155,22 +352,23 @@ private:
 		{ 1.0, 0.0, 0.0 }
 	};
 
-	// Use slightly offset from edge to prevent the edge of the next texture showing through
+	// Texture coordinates in tiles across a face. These are scaled by the size of merged faces so
+	// that the texture repeats rather than stretches, which the material layers do by themselves.
 	inline constexpr static float textures[] = {
-		0.01, 0.01,
-		0.01, 0.99,
-		0.99, 0.01,
-		0.99, 0.01,
-		0.01, 0.99,
-		0.99, 0.99
+		0.0, 0.0,
+		0.0, 1.0,
+		1.0, 0.0,
+		1.0, 1.0
 	};
 
-	// For each block type, the indices reference the locations in the texture for a face
+	// For each block type, the material layer of each face
 	inline constexpr static int blockIndices[MaxBlocks][6] = {
 		{ 0, 1, 2, 2, 2, 2 }, // Topsoil
 		{ 1, 1, 1, 1, 1, 1 }, // Dirt
-		{ 16, 16, 16, 16, 16, 16 }, // Stone
+		{ 3, 3, 3, 3, 3, 3 }, // Stone
 	};
 };
 
+static_assert(sizeof(BlockInstance::PackedVertex) == 8, "PackedVertex must stay 8 bytes");
+
 #endif
@@ -1,9 +1,9 @@
 #include "camera.hpp"
 
-Camera::Camera(glm::vec3 pos,  glm::vec3 rot, float fov, float ratio) : pos(pos), rot(rot)
+Camera::Camera(glm::vec3 pos,  glm::vec3 rot, float fov, float ratio, float far_plane) : pos(pos), rot(rot)
 {
 	orientation = glm::vec3(0, 1, 0);
-	proj_mat = glm::perspective(fov, ratio, 0.1f, 256.0f);
+	proj_mat = glm::perspective(fov, ratio, 0.1f, far_plane);
 
 	glm::vec3 move_non(0, 0, 0);
 	glm::vec3 rotate_non(0, 0, 0);
@@ -24,12 +24,27 @@ void Camera::move(glm::vec3 &move, glm::vec3 &rotate)
 	glm::vec3 strafe(view_mat[0][0], view_mat[1][0], view_mat[2][0]);
 	glm::vec3 height(view_mat[0][1], view_mat[1][1], view_mat[1][2]);
 	glm::vec3 forward(view_mat[0][2], view_mat[1][2], view_mat[2][2]);
-	pos += move.x * strafe + move.y * height + move.z * forward;
+	last_move = move.x * strafe + move.y * height + move.z * forward;
+	pos += last_move;
 
 	rot.x += rotate.x;
 	rot.y += rotate.y;
 	rot.z += rotate.z;
 
+	updateView();
+}
+
+void Camera::setPose(const glm::vec3 &position, const glm::vec3 &rotation)
+{
+	last_move = position - pos;
+	pos = position;
+	rot = rotation;
+
+	updateView();
+}
+
+void Camera::updateView()
+{
 	glm::mat4 pitch = glm::mat4(1.0f);
 	pitch = glm::rotate(pitch, rot.x, glm::vec3(1.0f, 0.0f, 0.0f));
 
@@ -45,9 +60,3 @@ void Camera::move(glm::vec3 &move, glm::vec3 &rotate)
 	view_mat = roll * pitch * yaw * trans;
 }
 
-void Camera::setUniform(GLuint program_id, const char *name)
-{
-	GLuint id = glGetUniformLocation(program_id, name);
-	glUniform3fv(id, 1, &pos[0]);
-}
-
@@ -16,21 +16,30 @@
 class Camera
 {
 public:
-	Camera(glm::vec3 pos, glm::vec3 rot, float fov, float ratio);
+	Camera(glm::vec3 pos, glm::vec3 rot, float fov, float ratio, float far_plane = 256.0f);
 	virtual ~Camera();
 
 	void setLookAt(glm::vec3 &lookAt);
-	void setUniform(GLuint program_id, const char *name);
 	void move(glm::vec3 &move, glm::vec3 &rotate);
 
+	// Place the camera directly, e.g. from a recorded path. Rotation is pitch, yaw and roll in radians.
+	void setPose(const glm::vec3 &position, const glm::vec3 &rotation);
+
 	glm::vec3 &position() { return pos; }
+	const glm::vec3 &rotation() const { return rot; }
+
+	// World space distance moved by the last call to move()
+	const glm::vec3 &lastMove() const { return last_move; }
 	glm::mat4 &view() { return view_mat; }
 	glm::mat4 &projection() { return proj_mat; }
 
 private:
+	void updateView();
+
 	glm::vec3 pos;
 	glm::vec3 rot;
 	glm::vec3 orientation;
+	glm::vec3 last_move = glm::vec3(0, 0, 0);
 	glm::mat4 view_mat;
 	glm::mat4 proj_mat;
 };
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "camera_path.hpp"
+
+// Point between b and c on the uniform Catmull-Rom spline through a, b, c and d
+static glm::vec3 catmullRom(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d, float s)
+{
+	float s2 = s * s;
+	float s3 = s2 * s;
+	return 0.5f * ((2.0f * b) + (c - a) * s + (2.0f * a - 5.0f * b + 4.0f * c - d) * s2 + (3.0f * b - a - 3.0f * c + d) * s3);
+}
+
+bool CameraPath::load(const string &filename)
+{
+	ifstream file(filename);
+	if (!file)
+	{
+		cerr << "Unable to open camera path " << filename << endl;
+		return false;
+	}
+
+	keyframes.clear();
+
+	string line;
+	int line_number = 0;
+	while (getline(file, line))
+	{
+		line_number++;
+
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == string::npos || line[first] == '#')
+		{
+			continue;
+		}
+
+		Keyframe keyframe;
+		istringstream fields(line);
+		fields >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >>
+			keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z;
+		if (!fields)
+		{
+			cerr << "Line " << line_number << " of camera path " << filename << " isn't time, x, y, z, pitch, yaw and roll\n";
+			return false;
+		}
+
+		if (!keyframes.empty() && keyframe.time <= keyframes.back().time)
+		{
+			cerr << "Line " << line_number << " of camera path " << filename << " isn't later than the line before\n";
+			return false;
+		}
+
+		keyframes.push_back(keyframe);
+	}
+
+	if (keyframes.empty())
+	{
+		cerr << "Camera path " << filename << " has no keyframes\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool CameraPath::save(const string &filename) const
+{
+	ofstream file(filename);
+	if (!file)
+	{
+		cerr << "Unable to write camera path " << filename << endl;
+		return false;
+	}
+
+	file << "# time x y z pitch yaw roll\n";
+	for (const auto &keyframe : keyframes)
+	{
+		file << keyframe.time << " " << keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << " " <<
+			keyframe.rotation.x << " " << keyframe.rotation.y << " " << keyframe.rotation.z << "\n";
+	}
+
+	return static_cast<bool>(file);
+}
+
+void CameraPath::add(float time, const glm::vec3 &position, const glm::vec3 &rotation)
+{
+	if (!keyframes.empty() && time <= keyframes.back().time)
+	{
+		return;
+	}
+
+	keyframes.push_back(Keyframe{ time, position, rotation });
+}
+
+void CameraPath::sample(float time, glm::vec3 &position, glm::vec3 &rotation) const
+{
+	if (keyframes.empty())
+	{
+		return;
+	}
+
+	if (time <= keyframes.front().time || keyframes.size() == 1)
+	{
+		position = keyframes.front().position;
+		rotation = keyframes.front().rotation;
+		return;
+	}
+
+	if (time >= keyframes.back().time)
+	{
+		position = keyframes.back().position;
+		rotation = keyframes.back().rotation;
+		return;
+	}
+
+	// Segment from b to c, with the keyframes either side repeated at the ends
+	auto next = upper_bound(keyframes.begin(), keyframes.end(), time,
+							[](float t, const Keyframe &keyframe) { return t < keyframe.time; });
+	size_t c = static_cast<size_t>(next - keyframes.begin());
+	size_t b = c - 1;
+	size_t a = b > 0 ? b - 1 : b;
+	size_t d = c + 1 < keyframes.size() ? c + 1 : c;
+
+	float s = (time - keyframes[b].time) / (keyframes[c].time - keyframes[b].time);
+	position = catmullRom(keyframes[a].position, keyframes[b].position, keyframes[c].position, keyframes[d].position, s);
+	rotation = catmullRom(keyframes[a].rotation, keyframes[b].rotation, keyframes[c].rotation, keyframes[d].rotation, s);
+}
@@ -0,0 +1,55 @@
+#ifndef __CAMERA_PATH_HPP__
+#define __CAMERA_PATH_HPP__
+
+#include <string>
+#include <vector>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+using namespace std;
+
+/**
+ * A route for the camera as keyframes of time, position and rotation, kept in a text file with
+ * one keyframe a line:
+ *
+ *     # time x y z pitch yaw roll
+ *     0.0   0 0 64   0 0 0
+ *     5.0  40 4 20   -0.2 1.57 0
+ *
+ * Times are in seconds from the start and angles in radians, as Camera takes them. Lines starting
+ * with # are comments. Between keyframes the camera follows a Catmull-Rom spline through them, so
+ * a few hand written points make a smooth flight and a recording plays back the route it took.
+ */
+class CameraPath
+{
+public:
+	struct Keyframe
+	{
+		float time;
+		glm::vec3 position;
+		glm::vec3 rotation;
+	};
+
+	/// Read a path, replacing any keyframes already held. False, with a message, if it is unreadable.
+	bool load(const string &filename);
+	bool save(const string &filename) const;
+
+	/// Append a keyframe, which has to be later than the last one.
+	void add(float time, const glm::vec3 &position, const glm::vec3 &rotation);
+
+	bool empty() const { return keyframes.empty(); }
+	size_t size() const { return keyframes.size(); }
+
+	/// Time of the last keyframe.
+	float duration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+
+	/// Pose at a time along the path, held at the ends before the first and after the last keyframe.
+	void sample(float time, glm::vec3 &position, glm::vec3 &rotation) const;
+
+private:
+	vector<Keyframe> keyframes;
+};
+
+#endif // __CAMERA_PATH_HPP__
@@ -0,0 +1,29 @@
+#ifndef __CHUNK_COORD_HPP__
+#define __CHUNK_COORD_HPP__
+
+#include <cstddef>
+
+/**
+ * Integer coordinates of a chunk (a BlockInstance) in the chunk grid.
+ */
+struct ChunkCoord
+{
+	int x;
+	int y;
+	int z;
+
+	bool operator==(const ChunkCoord &other) const { return x == other.x && y == other.y && z == other.z; }
+	bool operator!=(const ChunkCoord &other) const { return !(*this == other); }
+};
+
+struct ChunkCoordHash
+{
+	size_t operator()(const ChunkCoord &coord) const
+	{
+		// Large primes to spread neighbouring coordinates across the buckets
+		return (static_cast<size_t>(coord.x) * 73856093u) ^ (static_cast<size_t>(coord.y) * 19349663u) ^
+			(static_cast<size_t>(coord.z) * 83492791u);
+	}
+};
+
+#endif // __CHUNK_COORD_HPP__
@@ -0,0 +1,506 @@
+#include <iostream>
+#include <algorithm>
+#include "chunk_geometry.hpp"
+#include "quad_indices.hpp"
+#include "gl_stats.hpp"
+
+ChunkGeometry::ChunkGeometry(size_t initial_vertices)
+{
+	indirect = GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+
+	glGenVertexArrays(1, &vertex_array_id);
+	glGenBuffers(1, &origin_buffer);
+	glGenTextures(1, &origin_texture);
+
+	if (indirect)
+	{
+		glGenBuffers(1, &indirect_buffer);
+	}
+
+	grow(max<size_t>(initial_vertices, QuadIndices::VerticesPerQuad));
+}
+
+ChunkGeometry::~ChunkGeometry()
+{
+	glDeleteVertexArrays(1, &vertex_array_id);
+	glDeleteBuffers(1, &vertex_buffer);
+	glDeleteBuffers(1, &origin_buffer);
+	glDeleteTextures(1, &origin_texture);
+
+	if (indirect_buffer)
+	{
+		glDeleteBuffers(1, &indirect_buffer);
+	}
+}
+
+void ChunkGeometry::grow(size_t min_capacity)
+{
+	size_t new_capacity = max(min_capacity, vertex_capacity * 2);
+
+	GLuint new_buffer;
+	glGenBuffers(1, &new_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, new_buffer);
+	glBufferData(GL_ARRAY_BUFFER, new_capacity * sizeof(BlockInstance::PackedVertex), nullptr, GL_DYNAMIC_DRAW);
+
+	// Meshes keep their offsets, so only the data has to move
+	if (vertex_buffer)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, vertex_buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, vertex_capacity * sizeof(BlockInstance::PackedVertex));
+		glDeleteBuffers(1, &vertex_buffer);
+	}
+
+	// The new space is zeroed to match the mirror, so writes that skip unchanged vertices stay right
+	size_t added = new_capacity - vertex_capacity;
+	vector<BlockInstance::PackedVertex> zeros(added);
+	GL_UPLOAD(added * sizeof(BlockInstance::PackedVertex),
+			  glBufferSubData(GL_ARRAY_BUFFER, vertex_capacity * sizeof(BlockInstance::PackedVertex),
+							  added * sizeof(BlockInstance::PackedVertex), zeros.data()));
+
+	// The new space goes on the end of the free list, joining up with any free space before it
+	size_t first = vertex_capacity;
+	size_t count = new_capacity - vertex_capacity;
+	if (!free_ranges.empty())
+	{
+		auto last = prev(free_ranges.end());
+		if (last->first + last->second == first)
+		{
+			first = last->first;
+			count += last->second;
+			free_ranges.erase(last);
+		}
+	}
+	free_ranges[first] = count;
+
+	vertex_buffer = new_buffer;
+	vertex_capacity = new_capacity;
+	contents.resize(new_capacity);
+
+	glBindVertexArray(vertex_array_id);
+	QuadIndices::bind(max_quads);
+
+	glEnableVertexAttribArray(4);
+	glVertexAttribIPointer(
+		4,
+		2,
+		GL_UNSIGNED_INT,
+		sizeof(BlockInstance::PackedVertex),
+		(void*)0
+		);
+	glBindVertexArray(0);
+}
+
+bool ChunkGeometry::reserve(size_t num_vertices, size_t &first_vertex)
+{
+	// First fit, splitting what is left over back into the free list
+	for (auto range = free_ranges.begin(); range != free_ranges.end(); ++range)
+	{
+		if (range->second >= num_vertices)
+		{
+			first_vertex = range->first;
+			size_t remaining = range->second - num_vertices;
+			free_ranges.erase(range);
+
+			if (remaining > 0)
+			{
+				free_ranges[first_vertex + num_vertices] = remaining;
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ChunkGeometry::extend(size_t end_vertex, size_t num_vertices)
+{
+	// Only possible when the free space starts right where the range ends
+	auto range = free_ranges.find(end_vertex);
+	if (range == free_ranges.end() || range->second < num_vertices)
+	{
+		return false;
+	}
+
+	size_t remaining = range->second - num_vertices;
+	free_ranges.erase(range);
+	if (remaining > 0)
+	{
+		free_ranges[end_vertex + num_vertices] = remaining;
+	}
+	return true;
+}
+
+void ChunkGeometry::freeRange(size_t first, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Join up with free space either side
+	auto next = free_ranges.lower_bound(first);
+	if (next != free_ranges.end() && first + count == next->first)
+	{
+		count += next->second;
+		next = free_ranges.erase(next);
+	}
+	if (next != free_ranges.begin())
+	{
+		auto before = prev(next);
+		if (before->first + before->second == first)
+		{
+			first = before->first;
+			count += before->second;
+			free_ranges.erase(before);
+		}
+	}
+
+	free_ranges[first] = count;
+}
+
+void ChunkGeometry::setOrigin(int slot, const glm::vec3 &origin)
+{
+	origins[slot] = glm::vec4(origin, 0.0f);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, origin_buffer);
+	if (origins.size() > origin_capacity)
+	{
+		// Reallocate for the whole list with room to spare, the buffer texture follows the new storage
+		origin_capacity = max<size_t>(origins.size(), origin_capacity * 2);
+		glBufferData(GL_TEXTURE_BUFFER, origin_capacity * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+		GL_UPLOAD(origins.size() * sizeof(glm::vec4), glBufferSubData(GL_TEXTURE_BUFFER, 0, origins.size() * sizeof(glm::vec4), origins.data()));
+
+		glBindTexture(GL_TEXTURE_BUFFER, origin_texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, origin_buffer);
+		return;
+	}
+
+	GL_UPLOAD(sizeof(glm::vec4), glBufferSubData(GL_TEXTURE_BUFFER, slot * sizeof(glm::vec4), sizeof(glm::vec4), &origins[slot]));
+}
+
+int ChunkGeometry::allocate(const vector<BlockInstance::PackedVertex> &vertices, const glm::vec3 &origin)
+{
+	int slot;
+	if (!free_slots.empty())
+	{
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else if (slots.size() < MaxSlots)
+	{
+		slot = static_cast<int>(slots.size());
+		slots.emplace_back();
+		origins.emplace_back();
+	}
+	else
+	{
+		cerr << "Out of chunk geometry slots, block will not be drawn\n";
+		return -1;
+	}
+
+	size_t first_vertex;
+	if (!reserve(vertices.size(), first_vertex))
+	{
+		grow(vertex_capacity + vertices.size());
+		reserve(vertices.size(), first_vertex);
+	}
+
+	Slot &entry = slots[slot];
+	entry.first_vertex = first_vertex;
+	entry.num_vertices = vertices.size();
+	entry.in_use = true;
+	vertices_used += vertices.size();
+
+	tag(slot, vertices);
+	write(first_vertex, staging);
+	setOrigin(slot, origin);
+	fitQuads(vertices.size());
+	return slot;
+}
+
+void ChunkGeometry::update(int slot, const vector<BlockInstance::PackedVertex> &vertices)
+{
+	if (slot < 0 || static_cast<size_t>(slot) >= slots.size() || !slots[slot].in_use)
+	{
+		return;
+	}
+
+	Slot &entry = slots[slot];
+	tag(slot, vertices);
+	bool keep_layout = arrange(entry);
+
+	// Shrink or grow in place if possible, keeping unchanged quads where they are. Failing that the
+	// compacted mesh is used, since gaps only pay off in place, and it moves if it doesn't fit. Moving
+	// may well land on some of the same space since freeing it first joins it up with the space either side.
+	size_t first = entry.first_vertex;
+	size_t count = entry.num_vertices;
+	if (keep_layout && layout.size() <= count)
+	{
+		freeRange(first + layout.size(), count - layout.size());
+	}
+	else if (!keep_layout || !extend(first + count, layout.size() - count))
+	{
+		keep_layout = false;
+		if (staging.size() <= count)
+		{
+			freeRange(first + staging.size(), count - staging.size());
+		}
+		else if (!extend(first + count, staging.size() - count))
+		{
+			freeRange(first, count);
+			if (!reserve(staging.size(), first))
+			{
+				grow(vertex_capacity + staging.size());
+				reserve(staging.size(), first);
+			}
+		}
+	}
+	const vector<BlockInstance::PackedVertex> &data = keep_layout ? layout : staging;
+
+	entry.first_vertex = first;
+	entry.num_vertices = data.size();
+	vertices_used = vertices_used - count + data.size();
+
+	write(first, data);
+	fitQuads(data.size());
+}
+
+void ChunkGeometry::tag(int slot, const vector<BlockInstance::PackedVertex> &vertices)
+{
+	// Tag each vertex with the slot so the shader can find the origin
+	staging.resize(vertices.size());
+	for (size_t i=0; i<vertices.size(); i++)
+	{
+		staging[i].geometry = vertices[i].geometry;
+		staging[i].material = (vertices[i].material & 0xffff) | (static_cast<uint32_t>(slot) << 16);
+	}
+}
+
+static bool sameVertex(const BlockInstance::PackedVertex &a, const BlockInstance::PackedVertex &b)
+{
+	return a.geometry == b.geometry && a.material == b.material;
+}
+
+static bool sameQuad(const BlockInstance::PackedVertex *a, const BlockInstance::PackedVertex *b)
+{
+	return equal(a, a + QuadIndices::VerticesPerQuad, b, sameVertex);
+}
+
+// Gaps are quads with all four corners in the same place, which draw nothing. Real faces never are.
+static bool isGap(const BlockInstance::PackedVertex *quad)
+{
+	return sameVertex(quad[0], quad[1]) && sameVertex(quad[0], quad[2]) && sameVertex(quad[0], quad[3]);
+}
+
+static uint64_t hashQuad(const BlockInstance::PackedVertex *quad)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i=0; i<QuadIndices::VerticesPerQuad; i++)
+	{
+		hash = (hash ^ quad[i].geometry) * 1099511628211ull;
+		hash = (hash ^ quad[i].material) * 1099511628211ull;
+	}
+	return hash;
+}
+
+bool ChunkGeometry::arrange(const Slot &entry)
+{
+	constexpr size_t Corners = QuadIndices::VerticesPerQuad;
+	const BlockInstance::PackedVertex *old = contents.data() + entry.first_vertex;
+	size_t old_quads = entry.num_vertices / Corners;
+	size_t new_quads = staging.size() / Corners;
+
+	// An edit usually leaves most of the faces of a block alone, but those after a face that comes
+	// or goes all move along in the new mesh. So quads of the old mesh that are still wanted stay
+	// where they are, new ones fill the gaps left by those that aren't and then go on the end, and
+	// only what has changed needs uploading.
+	quad_places.clear();
+	for (size_t quad=0; quad<old_quads; quad++)
+	{
+		if (!isGap(old + quad * Corners))
+		{
+			quad_places[hashQuad(old + quad * Corners)] = static_cast<uint32_t>(quad);
+		}
+	}
+
+	kept.assign(old_quads, 0);
+	added.clear();
+	for (size_t quad=0; quad<new_quads; quad++)
+	{
+		const BlockInstance::PackedVertex *vertices = staging.data() + quad * Corners;
+		auto place = quad_places.find(hashQuad(vertices));
+		if (place != quad_places.end() && !kept[place->second] && sameQuad(old + place->second * Corners, vertices))
+		{
+			kept[place->second] = 1;
+		}
+		else
+		{
+			added.push_back(static_cast<uint32_t>(quad));
+		}
+	}
+
+	BlockInstance::PackedVertex gap = { 0, staging.empty() ? 0 : staging[0].material & 0xffff0000 };
+	layout.assign(old, old + old_quads * Corners);
+	size_t next = 0;
+	for (size_t quad=0; quad<old_quads; quad++)
+	{
+		if (kept[quad])
+		{
+			continue;
+		}
+
+		if (next < added.size())
+		{
+			copy_n(staging.begin() + added[next++] * Corners, Corners, layout.begin() + quad * Corners);
+		}
+		else
+		{
+			fill_n(layout.begin() + quad * Corners, Corners, gap);
+		}
+	}
+	for (; next<added.size(); next++)
+	{
+		layout.insert(layout.end(), staging.begin() + added[next] * Corners, staging.begin() + (added[next] + 1) * Corners);
+	}
+
+	// Gaps at the end needn't be drawn at all
+	while (!layout.empty() && isGap(layout.data() + layout.size() - Corners))
+	{
+		layout.resize(layout.size() - Corners);
+	}
+
+	// Gaps still cost vertex shading, so once there is one for every four faces start afresh
+	size_t gaps = layout.size() / Corners - new_quads;
+	return gaps * 4 <= new_quads;
+}
+
+void ChunkGeometry::write(size_t first_vertex, const vector<BlockInstance::PackedVertex> &data)
+{
+	// Only runs of vertices that differ from what the buffer already holds are uploaded, with runs
+	// that are close together sent as one
+	constexpr size_t MergeGap = 64;
+
+	BlockInstance::PackedVertex *existing = contents.data() + first_vertex;
+	size_t i = 0;
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	while (i < data.size())
+	{
+		if (sameVertex(data[i], existing[i]))
+		{
+			i++;
+			continue;
+		}
+
+		size_t begin = i;
+		size_t end = i + 1;
+		for (i=end; i<data.size() && i<end+MergeGap; i++)
+		{
+			if (!sameVertex(data[i], existing[i]))
+			{
+				end = i + 1;
+			}
+		}
+		i = end;
+
+		copy(data.begin() + begin, data.begin() + end, existing + begin);
+		GL_UPLOAD((end - begin) * sizeof(BlockInstance::PackedVertex),
+				  glBufferSubData(GL_ARRAY_BUFFER, (first_vertex + begin) * sizeof(BlockInstance::PackedVertex),
+								  (end - begin) * sizeof(BlockInstance::PackedVertex), data.data() + begin));
+	}
+}
+
+void ChunkGeometry::fitQuads(size_t num_vertices)
+{
+	// Every draw reads from the start of the shared quad indices, so they have to cover the largest mesh
+	size_t num_quads = num_vertices / QuadIndices::VerticesPerQuad;
+	if (num_quads > max_quads)
+	{
+		max_quads = num_quads;
+		glBindVertexArray(vertex_array_id);
+		QuadIndices::bind(max_quads);
+		glBindVertexArray(0);
+	}
+}
+
+void ChunkGeometry::release(int slot)
+{
+	if (slot < 0 || static_cast<size_t>(slot) >= slots.size() || !slots[slot].in_use)
+	{
+		return;
+	}
+
+	Slot &entry = slots[slot];
+	vertices_used -= entry.num_vertices;
+	freeRange(entry.first_vertex, entry.num_vertices);
+	entry = Slot();
+	free_slots.push_back(slot);
+}
+
+void ChunkGeometry::submit(RenderQueue &queue, Program &program, Texture &texture)
+{
+	last_draws = draw_slots.size();
+	if (draw_slots.empty())
+	{
+		return;
+	}
+
+	// Block origins replace the model matrix
+	DrawPacket packet;
+	packet.program = &program;
+	packet.texture = &texture;
+	packet.vertex_array_id = vertex_array_id;
+	packet.flags = DrawPacket::FlagTiledUV | DrawPacket::FlagPackedVertex | DrawPacket::FlagSharedGeometry;
+	packet.draw = [this, &program]() { drawQueued(program); };
+
+	// Terrain goes first so that it hides as much as possible of what follows
+	queue.submit(move(packet), 0.0f);
+}
+
+void ChunkGeometry::drawQueued(Program &program)
+{
+	program.setUniform("Chunk_Origins", static_cast<int>(OriginsUnit));
+	GL_CALL(glActiveTexture(GL_TEXTURE0 + OriginsUnit));
+	GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, origin_texture));
+
+	size_t num_indices = 0;
+	if (indirect)
+	{
+		commands.clear();
+		for (int slot : draw_slots)
+		{
+			const Slot &entry = slots[slot];
+			IndirectCommand command;
+			command.count = static_cast<GLuint>(QuadIndices::numIndices(entry.num_vertices / QuadIndices::VerticesPerQuad));
+			command.instance_count = 1;
+			command.first_index = 0;
+			command.base_vertex = static_cast<GLint>(entry.first_vertex);
+			command.base_instance = 0;
+			commands.push_back(command);
+			num_indices += command.count;
+		}
+
+		GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer));
+		GL_UPLOAD(commands.size() * sizeof(IndirectCommand),
+				  glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(IndirectCommand), commands.data(), GL_STREAM_DRAW));
+		GL_DRAW(num_indices / 3, glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, static_cast<GLsizei>(commands.size()), 0));
+	}
+	else
+	{
+		counts.clear();
+		offsets.clear();
+		base_vertices.clear();
+		for (int slot : draw_slots)
+		{
+			const Slot &entry = slots[slot];
+			counts.push_back(static_cast<GLsizei>(QuadIndices::numIndices(entry.num_vertices / QuadIndices::VerticesPerQuad)));
+			offsets.push_back(nullptr);
+			base_vertices.push_back(static_cast<GLint>(entry.first_vertex));
+			num_indices += counts.back();
+		}
+
+		GL_DRAW(num_indices / 3, glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(),
+															   static_cast<GLsizei>(counts.size()), base_vertices.data()));
+	}
+
+	draw_slots.clear();
+}
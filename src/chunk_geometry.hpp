@@ -0,0 +1,134 @@
+#ifndef __CHUNK_GEOMETRY_HPP__
+#define __CHUNK_GEOMETRY_HPP__
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "blockinstance.hpp"
+#include "program.hpp"
+#include "texture.hpp"
+#include "render_queue.hpp"
+
+using namespace std;
+
+/**
+ * One vertex buffer shared by the packed meshes of every block, so that all of the blocks in view
+ * can be drawn with a single multi-draw call through one vertex array.
+ *
+ * Each mesh is given a slot. The slot is written into the top of the vertices' material word and
+ * the vertex shader uses it to look up the block's origin in a buffer texture, which takes the
+ * place of the per-block model matrix. Blocks drawn this way can only be translated.
+ */
+class ChunkGeometry
+{
+public:
+	/// Texture unit the buffer of block origins is bound to when drawing.
+	static constexpr GLuint OriginsUnit = 2;
+
+	/// Slots are stored in 16 bits of the packed vertex.
+	static constexpr size_t MaxSlots = 1 << 16;
+
+	ChunkGeometry(size_t initial_vertices = 1 << 18);
+	~ChunkGeometry();
+
+	ChunkGeometry(const ChunkGeometry &) = delete;
+	ChunkGeometry &operator=(const ChunkGeometry &) = delete;
+
+	/// Copy a mesh into the shared buffer. Returns its slot, or -1 if there are no slots left.
+	int allocate(const vector<BlockInstance::PackedVertex> &vertices, const glm::vec3 &origin);
+
+	/// Replace the mesh in a slot, keeping the slot. Faces that were in the old mesh keep their place
+	/// and only the parts of the range that change are uploaded. The space taken may include gaps
+	/// of faces that draw nothing, which are tidied up once there are enough of them.
+	void update(int slot, const vector<BlockInstance::PackedVertex> &vertices);
+
+	/// Free a slot and the space its vertices used.
+	void release(int slot);
+
+	/// Queue a slot to be drawn by the next submit().
+	void add(int slot) { draw_slots.push_back(slot); }
+
+	/// Hand everything added since the last call to the render queue as a single draw.
+	void submit(RenderQueue &queue, Program &program, Texture &texture);
+
+	/// True when draws go through an indirect buffer rather than glMultiDrawElementsBaseVertex.
+	bool usesIndirect() const { return indirect; }
+
+	size_t numDraws() const { return last_draws; }
+	size_t verticesUsed() const { return vertices_used; }
+	size_t capacity() const { return vertex_capacity; }
+
+private:
+	struct Slot
+	{
+		size_t first_vertex = 0;
+		size_t num_vertices = 0;
+		bool in_use = false;
+	};
+
+	// Same layout as GL's DrawElementsIndirectCommand
+	struct IndirectCommand
+	{
+		GLuint count;
+		GLuint instance_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+
+	bool reserve(size_t num_vertices, size_t &first_vertex);
+	bool extend(size_t end_vertex, size_t num_vertices);
+	void freeRange(size_t first_vertex, size_t num_vertices);
+	void grow(size_t min_capacity);
+	void tag(int slot, const vector<BlockInstance::PackedVertex> &vertices);
+	bool arrange(const Slot &entry);
+	void write(size_t first_vertex, const vector<BlockInstance::PackedVertex> &data);
+	void fitQuads(size_t num_vertices);
+	void setOrigin(int slot, const glm::vec3 &origin);
+	void drawQueued(Program &program);
+
+	GLuint vertex_array_id = 0;
+	GLuint vertex_buffer = 0;
+	GLuint origin_buffer = 0;
+	GLuint origin_texture = 0;
+	GLuint indirect_buffer = 0;
+	bool indirect = false;
+
+	size_t vertex_capacity = 0;
+	size_t vertices_used = 0;
+	size_t max_quads = 0;
+	map<size_t, size_t> free_ranges; // First vertex to number of vertices
+
+	// Copy of the vertex buffer, to find the part of a new mesh that differs from what is there
+	vector<BlockInstance::PackedVertex> contents;
+
+	vector<Slot> slots;
+	vector<int> free_slots;
+	vector<glm::vec4> origins;
+	size_t origin_capacity = 0;
+
+	// Reused each time to save allocating
+	vector<BlockInstance::PackedVertex> staging;
+	vector<BlockInstance::PackedVertex> layout;
+	unordered_map<uint64_t, uint32_t> quad_places;
+	vector<uint8_t> kept;
+	vector<uint32_t> added;
+	vector<int> draw_slots;
+	vector<GLsizei> counts;
+	vector<const void*> offsets;
+	vector<GLint> base_vertices;
+	vector<IndirectCommand> commands;
+	size_t last_draws = 0;
+};
+
+#endif // __CHUNK_GEOMETRY_HPP__
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <unordered_set>
+#include "chunk_loader.hpp"
+
+ChunkLoader::ChunkLoader(Reader reader, unsigned num_threads) : reader(reader)
+{
+	for (unsigned i=0; i<max(num_threads, 1u); i++)
+	{
+		workers.emplace_back(&ChunkLoader::run, this);
+	}
+}
+
+ChunkLoader::~ChunkLoader()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	work_ready.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ChunkLoader::schedule(const vector<pair<float, ChunkCoord>> &wanted)
+{
+	unordered_set<ChunkCoord, ChunkCoordHash> keep;
+	vector<pair<float, ChunkCoord>> next;
+	next.reserve(wanted.size());
+
+	{
+		lock_guard<mutex> guard(lock);
+
+		unordered_set<ChunkCoord, ChunkCoordHash> busy(in_flight.begin(), in_flight.end());
+		for (auto &entry : finished)
+		{
+			busy.insert(entry.first);
+		}
+
+		for (auto &entry : wanted)
+		{
+			if (busy.count(entry.second) == 0)
+			{
+				next.push_back(entry);
+				keep.insert(entry.second);
+			}
+		}
+
+		for (auto &entry : queued)
+		{
+			counters.cancelled += keep.count(entry.second) == 0;
+		}
+
+		sort(next.begin(), next.end(),
+			 [](const pair<float, ChunkCoord> &a, const pair<float, ChunkCoord> &b) { return a.first > b.first; });
+		queued = move(next);
+	}
+	work_ready.notify_all();
+}
+
+bool ChunkLoader::collect(ChunkCoord &coord, unique_ptr<BlockInstance> &block)
+{
+	lock_guard<mutex> guard(lock);
+	if (finished.empty())
+	{
+		return false;
+	}
+
+	// Chunks finish in roughly the order they were asked for, so the oldest are the most important
+	coord = finished.front().first;
+	block = move(finished.front().second);
+	finished.pop_front();
+	return true;
+}
+
+ChunkLoader::Stats ChunkLoader::stats() const
+{
+	lock_guard<mutex> guard(lock);
+	Stats current = counters;
+	current.queued = queued.size();
+	current.in_flight = in_flight.size();
+	current.finished = finished.size();
+	return current;
+}
+
+void ChunkLoader::run()
+{
+	while (true)
+	{
+		ChunkCoord coord;
+		{
+			unique_lock<mutex> guard(lock);
+			work_ready.wait(guard, [this] { return stopping || !queued.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			coord = queued.back().second;
+			queued.pop_back();
+			in_flight.push_back(coord);
+		}
+
+		unique_ptr<BlockInstance> block = reader(coord);
+
+		{
+			lock_guard<mutex> guard(lock);
+			in_flight.erase(find(in_flight.begin(), in_flight.end(), coord));
+			finished.push_back(make_pair(coord, move(block)));
+			counters.completed++;
+		}
+	}
+}
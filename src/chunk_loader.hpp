@@ -0,0 +1,69 @@
+#ifndef __CHUNK_LOADER_HPP__
+#define __CHUNK_LOADER_HPP__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+#include "blockinstance.hpp"
+#include "chunk_coord.hpp"
+
+using namespace std;
+
+/**
+ * Reads chunks on background threads so that disk access and decompression never hold up a
+ * frame. The owner hands over the full list of chunks it wants each frame, which replaces the
+ * queue: chunks missing from it are cancelled and the rest are read nearest first. Finished
+ * chunks wait until the owner collects them on the render thread.
+ */
+class ChunkLoader
+{
+public:
+	/// Creates a chunk and fills it with its voxels. Called on the loader's threads.
+	using Reader = function<unique_ptr<BlockInstance>(const ChunkCoord &coord)>;
+
+	struct Stats
+	{
+		size_t queued = 0;    // Chunks waiting to be read
+		size_t in_flight = 0; // Chunks being read right now
+		size_t finished = 0;  // Chunks read but not yet collected
+		size_t completed = 0; // Total chunks read so far
+		size_t cancelled = 0; // Total requests dropped before being read
+	};
+
+	ChunkLoader(Reader reader, unsigned num_threads = 1);
+	~ChunkLoader();
+
+	/// Replace the queue with the given chunks, lowest priority value first. Chunks already being
+	/// read or waiting to be collected are left alone, queued ones not in the list are cancelled.
+	void schedule(const vector<pair<float, ChunkCoord>> &wanted);
+
+	/// Take a finished chunk, false when there are none.
+	bool collect(ChunkCoord &coord, unique_ptr<BlockInstance> &block);
+
+	Stats stats() const;
+
+private:
+	void run();
+
+	Reader reader;
+	vector<thread> workers;
+
+	mutable mutex lock;
+	condition_variable work_ready;
+	bool stopping = false;
+
+	// Sorted with the most important chunk at the back
+	vector<pair<float, ChunkCoord>> queued;
+	vector<ChunkCoord> in_flight;
+	deque<pair<ChunkCoord, unique_ptr<BlockInstance>>> finished;
+	Stats counters;
+};
+
+#endif // __CHUNK_LOADER_HPP__
@@ -0,0 +1,355 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include "chunk_manager.hpp"
+
+// Chunk grid step for each face of a block, in the same order as BlockInstance::Face
+static const ChunkCoord face_steps[BlockInstance::MaxFaces] = {
+	{ 0, 1, 0 },  // Top
+	{ 0, -1, 0 }, // Bottom
+	{ 0, 0, -1 }, // Back
+	{ 0, 0, 1 },  // Front
+	{ -1, 0, 0 }, // Left
+	{ 1, 0, 0 }   // Right
+};
+
+// Faces come in pairs so the opposite face only differs in the lowest bit
+static BlockInstance::Face opposite(int face)
+{
+	return static_cast<BlockInstance::Face>(face ^ 1);
+}
+
+ChunkManager::ChunkManager(Texture &texture, Program &program, World &world, BlockMesher &mesher, ChunkSource source) :
+	texture(texture), program(program), world(world), mesher(mesher), source(source)
+{
+}
+
+ChunkManager::~ChunkManager()
+{
+	saveChanged();
+
+	// Make sure the mesher isn't left holding on to any of the chunks
+	for (auto &entry : resident)
+	{
+		mesher.cancel(*entry.second);
+	}
+}
+
+void ChunkManager::setBackgroundLoading(unsigned threads)
+{
+	loader = make_unique<ChunkLoader>([this](const ChunkCoord &coord) { return create(coord); }, threads);
+}
+
+void ChunkManager::update(const glm::vec3 &position, const glm::vec3 &velocity)
+{
+	// Where the camera will be shortly, so that the chunks it is heading for are read in time
+	glm::vec3 ahead = loader ? position + velocity * prefetch_time : position;
+	float range = static_cast<float>(radius);
+
+	// Evict chunks that are out of range, with a chunk of slack so that moving back and forth
+	// across the boundary doesn't keep reloading the same chunks
+	vector<ChunkCoord> leaving;
+	for (auto &entry : resident)
+	{
+		if (distance(entry.first, position, ahead) > range + 1.0f)
+		{
+			leaving.push_back(entry.first);
+		}
+	}
+
+	for (auto &coord : leaving)
+	{
+		evict(coord);
+	}
+
+	// Find the chunks in range of the path that still need loading, nearest the camera first as
+	// those are needed soonest
+	ChunkCoord centre = chunkAt(position);
+	ChunkCoord next = chunkAt(ahead);
+	vector<pair<float, ChunkCoord>> missing;
+	for (int y=min_chunk_y; y<=max_chunk_y; y++)
+	{
+		for (int z=min(centre.z, next.z) - radius; z<=max(centre.z, next.z) + radius; z++)
+		{
+			for (int x=min(centre.x, next.x) - radius; x<=max(centre.x, next.x) + radius; x++)
+			{
+				ChunkCoord coord = { x, y, z };
+				if (distance(coord, position, ahead) <= range && resident.find(coord) == resident.end())
+				{
+					missing.push_back(make_pair(distance(coord, position), coord));
+				}
+			}
+		}
+	}
+
+	sort(missing.begin(), missing.end(),
+		 [](const pair<float, ChunkCoord> &a, const pair<float, ChunkCoord> &b) { return a.first < b.first; });
+
+	if (!loader)
+	{
+		size_t num_loads = min(missing.size(), max_loads);
+		for (size_t i=0; i<num_loads; i++)
+		{
+			add(missing[i].second, create(missing[i].second));
+		}
+
+		remesh();
+		counters.resident = resident.size();
+		counters.loading = (missing.size() - num_loads) + mesher.pending();
+		return;
+	}
+
+	loader->schedule(missing);
+
+	// Empty chunks cost next to nothing to add, so only those with voxels count towards the limit
+	size_t num_loads = 0;
+	ChunkCoord coord;
+	unique_ptr<BlockInstance> block;
+	while (num_loads < max_loads && loader->collect(coord, block))
+	{
+		// The camera may have turned away while the chunk was being read
+		if (distance(coord, position, ahead) > range + 1.0f || resident.find(coord) != resident.end())
+		{
+			counters.dropped++;
+			continue;
+		}
+
+		if (distance(coord, position) <= range)
+		{
+			counters.demand++;
+		}
+		else
+		{
+			counters.prefetched++;
+		}
+
+		num_loads += !block->isEmpty();
+		add(coord, move(block));
+	}
+
+	// Chunks that should be in view already but haven't been read yet
+	size_t waiting = 0;
+	size_t late = 0;
+	for (auto &entry : missing)
+	{
+		if (resident.find(entry.second) == resident.end())
+		{
+			waiting++;
+			late += distance(entry.second, position) <= range;
+		}
+	}
+
+	remesh();
+
+	ChunkLoader::Stats io = loader->stats();
+	counters.io_queued = io.queued + io.in_flight + io.finished;
+	counters.stalls += late > 0;
+	counters.resident = resident.size();
+	counters.loading = waiting + mesher.pending();
+}
+
+BlockInstance *ChunkManager::find(const ChunkCoord &coord) const
+{
+	auto found = resident.find(coord);
+	return found != resident.end() ? found->second.get() : nullptr;
+}
+
+void ChunkManager::remesh()
+{
+	// Loads, evictions and edits only mark chunks, so each is snapshotted once here however much
+	// happened to it since the last update. Checking every resident chunk is cheap next to meshing.
+	for (auto &entry : resident)
+	{
+		BlockInstance &block = *entry.second;
+		if (block.needsMesh())
+		{
+			mesher.submit(block);
+			counters.meshed++;
+		}
+	}
+}
+
+BlockInstance *ChunkManager::voxelAt(const glm::vec3 &position, glm::ivec3 &local) const
+{
+	BlockInstance *block = find(chunkAt(position));
+	if (!block)
+	{
+		return nullptr;
+	}
+
+	// Voxel centres sit on whole numbers, as for chunkAt
+	glm::vec3 offset = position - block->position() + glm::vec3(0.5f, 0.5f, 0.5f);
+	local.x = glm::clamp(static_cast<int>(floor(offset.x)), 0, BLOCK_WIDTH - 1);
+	local.y = glm::clamp(static_cast<int>(floor(offset.y)), 0, BLOCK_HEIGHT - 1);
+	local.z = glm::clamp(static_cast<int>(floor(offset.z)), 0, BLOCK_DEPTH - 1);
+	return block;
+}
+
+bool ChunkManager::setVoxel(const glm::vec3 &position, BlockInstance::Block type)
+{
+	glm::ivec3 local;
+	BlockInstance *block = voxelAt(position, local);
+	if (!block)
+	{
+		return false;
+	}
+
+	block->setBit(local.x, local.y, local.z, type);
+	counters.edits++;
+	return true;
+}
+
+BlockInstance::Block ChunkManager::voxel(const glm::vec3 &position) const
+{
+	glm::ivec3 local;
+	BlockInstance *block = voxelAt(position, local);
+	return block ? block->getBit(local.x, local.y, local.z) : BlockInstance::Block::Empty;
+}
+
+int ChunkManager::levelOfDetail(float distance) const
+{
+	if (lod_distance <= 0.0f)
+	{
+		return 0;
+	}
+
+	// Doubling the distance halves the size of a voxel on screen, so the levels get twice as far apart each time
+	int level = 0;
+	float limit = lod_distance * BLOCK_WIDTH;
+	while (level < BlockInstance::MaxLods - 1 && distance >= limit)
+	{
+		level++;
+		limit *= 2.0f;
+	}
+	return level;
+}
+
+ChunkCoord ChunkManager::chunkAt(const glm::vec3 &position) const
+{
+	// Voxel centres sit on whole numbers so a chunk starts half a voxel before its origin
+	glm::vec3 local = position - origin + glm::vec3(0.5f, 0.5f, 0.5f);
+	ChunkCoord coord;
+	coord.x = static_cast<int>(floor(local.x / BLOCK_WIDTH));
+	coord.y = static_cast<int>(floor(local.y / BLOCK_HEIGHT));
+	coord.z = static_cast<int>(floor(local.z / BLOCK_DEPTH));
+	return coord;
+}
+
+float ChunkManager::distance(const ChunkCoord &coord, const glm::vec3 &from, const glm::vec3 &to) const
+{
+	// Only the horizontal distance counts, the vertical range is fixed
+	float centre_x = origin.x + (static_cast<float>(coord.x) + 0.5f) * BLOCK_WIDTH - 0.5f;
+	float centre_z = origin.z + (static_cast<float>(coord.z) + 0.5f) * BLOCK_DEPTH - 0.5f;
+
+	// Nearest point on the line between the two positions
+	float path_x = to.x - from.x;
+	float path_z = to.z - from.z;
+	float length = path_x * path_x + path_z * path_z;
+	float along = 0.0f;
+	if (length > 0.0f)
+	{
+		along = glm::clamp(((centre_x - from.x) * path_x + (centre_z - from.z) * path_z) / length, 0.0f, 1.0f);
+	}
+
+	float dx = (centre_x - (from.x + path_x * along)) / BLOCK_WIDTH;
+	float dz = (centre_z - (from.z + path_z * along)) / BLOCK_DEPTH;
+	return sqrt(dx * dx + dz * dz);
+}
+
+unique_ptr<BlockInstance> ChunkManager::create(const ChunkCoord &coord) const
+{
+	auto block = make_unique<BlockInstance>(texture, program, world);
+	source(coord, *block);
+	block->clearDirty();
+	return block;
+}
+
+void ChunkManager::add(const ChunkCoord &coord, unique_ptr<BlockInstance> block)
+{
+	block->position() = origin + glm::vec3(coord.x * BLOCK_WIDTH, coord.y * BLOCK_HEIGHT, coord.z * BLOCK_DEPTH);
+	block->setMeshMode(mesh_mode);
+	block->setVertexFormat(vertex_format);
+	block->setGeometry(geometry);
+	block->setLodLevels(lod_distance > 0.0f ? BlockInstance::MaxLods : 1);
+
+	BlockInstance *loaded = block.get();
+	resident[coord] = move(block);
+
+	link(coord, loaded);
+	if (!loaded->isEmpty())
+	{
+		loaded->markForMesh();
+	}
+	counters.loaded++;
+}
+
+void ChunkManager::evict(const ChunkCoord &coord)
+{
+	auto found = resident.find(coord);
+	if (found == resident.end())
+	{
+		return;
+	}
+
+	// A chunk whose changes can't be saved stays loaded, so they aren't lost and are saved next time
+	if (!save(coord, *found->second))
+	{
+		return;
+	}
+
+	mesher.cancel(*found->second);
+	link(coord, nullptr);
+
+	// Freeing the block releases its GL buffers too
+	resident.erase(found);
+	counters.evicted++;
+}
+
+void ChunkManager::saveChanged()
+{
+	for (auto &entry : resident)
+	{
+		save(entry.first, *entry.second);
+	}
+}
+
+bool ChunkManager::save(const ChunkCoord &coord, BlockInstance &block)
+{
+	if (!sink || !block.isDirty())
+	{
+		return true;
+	}
+
+	if (!sink(coord, block))
+	{
+		cerr << "Unable to save chunk (" << coord.x << ", " << coord.y << ", " << coord.z << "), keeping its changes\n";
+		return false;
+	}
+
+	block.clearDirty();
+	return true;
+}
+
+void ChunkManager::link(const ChunkCoord &coord, BlockInstance *block)
+{
+	for (int face=0; face<BlockInstance::MaxFaces; face++)
+	{
+		ChunkCoord next = { coord.x + face_steps[face].x, coord.y + face_steps[face].y, coord.z + face_steps[face].z };
+		BlockInstance *neighbour = find(next);
+
+		if (block)
+		{
+			block->setNeighbour(static_cast<BlockInstance::Face>(face), neighbour);
+		}
+
+		// Faces along the shared border have changed so the neighbour needs remeshing
+		if (neighbour)
+		{
+			neighbour->setNeighbour(opposite(face), block);
+			if (!neighbour->isEmpty())
+			{
+				neighbour->markForMesh();
+			}
+		}
+	}
+}
@@ -0,0 +1,157 @@
+#ifndef __CHUNK_MANAGER_HPP__
+#define __CHUNK_MANAGER_HPP__
+
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <cstddef>
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "blockinstance.hpp"
+#include "chunk_coord.hpp"
+#include "chunk_loader.hpp"
+#include "block_mesher.hpp"
+#include "texture.hpp"
+#include "program.hpp"
+#include "world.hpp"
+
+using namespace std;
+
+/**
+ * Keeps the chunks within a radius of the camera loaded and meshed, and frees the ones that move
+ * out of it. Chunks are looked up by their grid coordinates so the world can be any size.
+ */
+class ChunkManager
+{
+public:
+	/// Fills a newly created chunk with its voxels.
+	using ChunkSource = function<void(const ChunkCoord &coord, BlockInstance &block)>;
+
+	/// Writes back a chunk that has been changed since it was loaded. False if it couldn't be written,
+	/// in which case the chunk keeps its changes and is written again later.
+	using ChunkSink = function<bool(const ChunkCoord &coord, const BlockInstance &block)>;
+
+	using ChunkMap = unordered_map<ChunkCoord, unique_ptr<BlockInstance>, ChunkCoordHash>;
+
+	struct Stats
+	{
+		size_t resident = 0; // Chunks currently in memory
+		size_t loading = 0;  // Chunks in range that aren't loaded or are waiting on a mesh
+		size_t loaded = 0;   // Total chunks loaded so far
+		size_t evicted = 0;  // Total chunks freed so far
+		size_t edits = 0;    // Total voxels changed through setVoxel
+		size_t meshed = 0;   // Total chunks sent to the mesher, at most once each per update
+
+		// Only counted when loading in the background
+		size_t io_queued = 0;  // Chunks waiting on or being read by the loader
+		size_t prefetched = 0; // Total chunks that were read before they came within the radius
+		size_t demand = 0;     // Total chunks that were still being read once within the radius
+		size_t stalls = 0;     // Total updates with chunks within the radius still being read
+		size_t dropped = 0;    // Total chunks read but no longer wanted by the time they were collected
+	};
+
+	ChunkManager(Texture &texture, Program &program, World &world, BlockMesher &mesher, ChunkSource source);
+	~ChunkManager();
+
+	/// World position of the corner voxel of chunk (0, 0, 0).
+	void setOrigin(const glm::vec3 &position) { origin = position; }
+
+	/// Residency radius in chunks across x and z, plus the range of chunk y coordinates to load.
+	void setRadius(int chunks) { radius = chunks; }
+	void setVerticalRange(int min_y, int max_y) { min_chunk_y = min_y; max_chunk_y = max_y; }
+
+	/// Limit on chunks created per update so that a big move doesn't stall a frame. When loading in
+	/// the background only chunks with voxels count towards it.
+	void setMaxLoadsPerUpdate(size_t count) { max_loads = count; }
+
+	void setMeshMode(BlockInstance::MeshMode mode) { mesh_mode = mode; }
+	void setVertexFormat(BlockInstance::VertexFormat format) { vertex_format = format; }
+
+	/// Distance in chunks beyond which blocks are drawn at half detail, 0 to always draw full detail.
+	/// Each further level of detail starts at twice the distance of the one before.
+	void setLodDistance(float chunks) { lod_distance = chunks; }
+
+	/// Level of detail to draw a block at from its distance to the camera in world units.
+	int levelOfDetail(float distance) const;
+
+	/// Shared buffer for packed meshes, nullptr for a vertex array per block.
+	void setGeometry(ChunkGeometry *shared) { geometry = shared; }
+
+	/// Where changed chunks are saved when they are evicted, by saveChanged() and on destruction.
+	/// The sink has to outlive the manager. Without one changes are lost.
+	void setChunkSink(ChunkSink save) { sink = save; }
+	void saveChanged();
+
+	/// Read chunks on background threads rather than in update(). The chunk source is then called
+	/// from those threads, so it has to be safe to call from more than one thread at a time.
+	void setBackgroundLoading(unsigned threads = 1);
+
+	/// How far ahead of the camera chunks are read when loading in the background, as the time it
+	/// would take to get there at the current velocity. Zero only reads chunks within the radius.
+	void setPrefetchTime(float seconds) { prefetch_time = seconds; }
+
+	/// Load and evict chunks around the given position, plus those around the path ahead of it along
+	/// the velocity (in world units a second) when loading in the background, then remesh every
+	/// chunk whose mesh is out of date. Call once per frame.
+	void update(const glm::vec3 &position, const glm::vec3 &velocity = glm::vec3(0, 0, 0));
+
+	/// Look up a resident chunk, nullptr if it isn't loaded.
+	BlockInstance *find(const ChunkCoord &coord) const;
+
+	/// Change the voxel at a world position. False if its chunk isn't loaded. The chunk, and any
+	/// neighbour sharing a face with the voxel, is remeshed by the next update however many of its
+	/// voxels change before then.
+	bool setVoxel(const glm::vec3 &position, BlockInstance::Block type);
+
+	/// The voxel at a world position, empty if its chunk isn't loaded.
+	BlockInstance::Block voxel(const glm::vec3 &position) const;
+
+	ChunkMap &chunks() { return resident; }
+	const Stats &stats() const { return counters; }
+
+private:
+	ChunkCoord chunkAt(const glm::vec3 &position) const;
+	BlockInstance *voxelAt(const glm::vec3 &position, glm::ivec3 &local) const;
+	void remesh();
+	float distance(const ChunkCoord &coord, const glm::vec3 &position) const { return distance(coord, position, position); }
+	float distance(const ChunkCoord &coord, const glm::vec3 &from, const glm::vec3 &to) const;
+
+	unique_ptr<BlockInstance> create(const ChunkCoord &coord) const;
+	void add(const ChunkCoord &coord, unique_ptr<BlockInstance> block);
+	void evict(const ChunkCoord &coord);
+	bool save(const ChunkCoord &coord, BlockInstance &block);
+	void link(const ChunkCoord &coord, BlockInstance *block);
+
+	Texture &texture;
+	Program &program;
+	World &world;
+	BlockMesher &mesher;
+	ChunkSource source;
+	ChunkSink sink;
+
+	glm::vec3 origin = glm::vec3(0, 0, 0);
+	int radius = 8;
+	int min_chunk_y = 0;
+	int max_chunk_y = 0;
+	size_t max_loads = 8;
+
+	BlockInstance::MeshMode mesh_mode = BlockInstance::MeshGreedy;
+	BlockInstance::VertexFormat vertex_format = BlockInstance::FormatPacked;
+	ChunkGeometry *geometry = nullptr;
+	float lod_distance = 0.0f;
+	float prefetch_time = 1.0f;
+
+	ChunkMap resident;
+	Stats counters;
+
+	// Last so that its threads stop before anything they use is destroyed
+	unique_ptr<ChunkLoader> loader;
+};
+
+#endif // __CHUNK_MANAGER_HPP__
@@ -0,0 +1,93 @@
+// Writes the built in Ant Attack map out as region files that Orbis can load with --world
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <memory>
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "region_file.hpp"
+#include "ant_attack.hpp"
+
+using namespace std;
+
+// Values of BlockInstance::Block, which can't be included here without pulling in GL
+constexpr int32_t Topsoil = 0;
+constexpr int32_t Stone = 2;
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " <directory>\n";
+		return 1;
+	}
+
+	string directory = argv[1];
+	if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+	{
+		cerr << "Unable to create " << directory << ": " << strerror(errno) << endl;
+		return 1;
+	}
+
+	constexpr int size = RegionFile::ChunkSize;
+	constexpr int map_chunks = ant_attack_size / size;
+
+	// Same layout as the built in map: chunk (0, 0, 0) at the corner and a layer of topsoil under the stone
+	map<pair<int, int>, unique_ptr<RegionFile>> regions;
+	vector<int32_t> voxels(RegionFile::ChunkVoxels);
+	size_t written = 0;
+
+	for (int cz=0; cz<map_chunks; cz++)
+	{
+		for (int cx=0; cx<map_chunks; cx++)
+		{
+			fill(voxels.begin(), voxels.end(), -1);
+
+			for (int z=0; z<size; z++)
+			{
+				for (int x=0; x<size; x++)
+				{
+					int idx = ((cz * size + z) * ant_attack_size) + (cx * size + x);
+					voxels[(z * size) * size + x] = Topsoil;
+					for (int y=0; y<6; y++)
+					{
+						if ((map_data[idx] & (0x1 << y)) != 0)
+						{
+							voxels[(z * size + y + 1) * size + x] = Stone;
+						}
+					}
+				}
+			}
+
+			auto key = make_pair(cx / RegionFile::Size, cz / RegionFile::Size);
+			auto &region = regions[key];
+			if (!region)
+			{
+				region = make_unique<RegionFile>(directory + "/" + RegionFile::fileName(key.first, 0, key.second));
+				if (!region->isValid())
+				{
+					return 1;
+				}
+			}
+
+			if (!region->write(cx % RegionFile::Size, 0, cz % RegionFile::Size, voxels))
+			{
+				return 1;
+			}
+			written++;
+		}
+	}
+
+	size_t sectors = 0;
+	for (auto &entry : regions)
+	{
+		sectors += entry.second->numSectors();
+	}
+
+	cout << "Wrote " << written << " chunks to " << regions.size() << " region files in " << directory << ", " <<
+		sectors * RegionFile::SectorSize / 1024 << " KB\n";
+	return 0;
+}
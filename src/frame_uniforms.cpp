@@ -0,0 +1,29 @@
+#include "frame_uniforms.hpp"
+#include "gl_stats.hpp"
+
+FrameUniforms::FrameUniforms()
+{
+	glGenBuffers(1, &buffer_id);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer_id);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, Binding, buffer_id);
+}
+
+FrameUniforms::~FrameUniforms()
+{
+	glDeleteBuffers(1, &buffer_id);
+}
+
+void FrameUniforms::update(Camera &camera, Light &light)
+{
+	Block block;
+	block.view = camera.view();
+	block.projection = camera.projection();
+	block.view_projection = camera.projection() * camera.view();
+	block.camera_pos = glm::vec4(camera.position(), 1.0f);
+	block.light_pos = glm::vec4(light.position(), 1.0f);
+	block.light_col = glm::vec4(light.color(), 1.0f);
+
+	GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, buffer_id));
+	GL_UPLOAD(sizeof(Block), glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block));
+}
@@ -0,0 +1,48 @@
+#ifndef __FRAME_UNIFORMS_HPP__
+#define __FRAME_UNIFORMS_HPP__
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "camera.hpp"
+#include "light.hpp"
+
+/**
+ * Uniform buffer holding the values that are the same for every object in a frame: the camera
+ * matrices and position and the light. Programs read it through the Frame uniform block.
+ */
+class FrameUniforms
+{
+public:
+	/// Uniform buffer binding point that programs attach the Frame block to.
+	static constexpr GLuint Binding = 0;
+
+	FrameUniforms();
+	~FrameUniforms();
+
+	FrameUniforms(const FrameUniforms &) = delete;
+	FrameUniforms &operator=(const FrameUniforms &) = delete;
+
+	/// Upload this frame's values. Call once per frame before drawing.
+	void update(Camera &camera, Light &light);
+
+private:
+	// Matches the std140 layout of the Frame block in the shaders, vec3s are padded to vec4s
+	struct Block
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 view_projection;
+		glm::vec4 camera_pos;
+		glm::vec4 light_pos;
+		glm::vec4 light_col;
+	};
+
+	GLuint buffer_id = 0;
+};
+
+#endif // __FRAME_UNIFORMS_HPP__
@@ -0,0 +1,58 @@
+#include "frustum.hpp"
+
+AABB AABB::transform(const glm::mat4 &matrix) const
+{
+	AABB box(glm::vec3(matrix * glm::vec4(min, 1.0f)), glm::vec3(matrix * glm::vec4(min, 1.0f)));
+
+	for (int i=1; i<8; i++)
+	{
+		glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+		glm::vec3 moved = glm::vec3(matrix * glm::vec4(corner, 1.0f));
+
+		box.min = glm::min(box.min, moved);
+		box.max = glm::max(box.max, moved);
+	}
+
+	return box;
+}
+
+void Frustum::update(const glm::mat4 &view_projection)
+{
+	// Gribb and Hartmann: each plane is the last row of the matrix plus or minus one of the others
+	glm::vec4 rows[4];
+	for (int i=0; i<4; i++)
+	{
+		rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0]; // Left
+	planes[1] = rows[3] - rows[0]; // Right
+	planes[2] = rows[3] + rows[1]; // Bottom
+	planes[3] = rows[3] - rows[1]; // Top
+	planes[4] = rows[3] + rows[2]; // Near
+	planes[5] = rows[3] - rows[2]; // Far
+
+	counters = Stats();
+}
+
+bool Frustum::isVisible(const AABB &box)
+{
+	counters.tested++;
+
+	for (const auto &plane : planes)
+	{
+		// The corner furthest along the plane normal is the last to leave the frustum
+		glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x,
+						 plane.y >= 0.0f ? box.max.y : box.min.y,
+						 plane.z >= 0.0f ? box.max.z : box.min.z);
+
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+		{
+			counters.culled++;
+			return false;
+		}
+	}
+
+	counters.visible++;
+	return true;
+}
@@ -0,0 +1,54 @@
+#ifndef __FRUSTUM_HPP__
+#define __FRUSTUM_HPP__
+
+#include <cstddef>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+/**
+ * Axis aligned bounding box in whatever space its corners are given in.
+ */
+struct AABB
+{
+	glm::vec3 min = glm::vec3(0, 0, 0);
+	glm::vec3 max = glm::vec3(0, 0, 0);
+
+	AABB() {}
+	AABB(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {}
+
+	/// Box around all eight corners after transforming them, e.g. from model to world space.
+	AABB transform(const glm::mat4 &matrix) const;
+};
+
+/**
+ * The six planes of the camera's view volume, used to skip objects that can't be seen. Each
+ * frame call update() and then test objects with isVisible(), which also counts the results.
+ */
+class Frustum
+{
+public:
+	struct Stats
+	{
+		size_t tested = 0;  // Objects tested this frame
+		size_t visible = 0; // Objects at least partly inside the frustum
+		size_t culled = 0;  // Objects skipped
+	};
+
+	/// Take the planes from a projection * view matrix, giving them in world space. Resets the stats.
+	void update(const glm::mat4 &view_projection);
+
+	/// False if the box is entirely outside of one of the planes. Boxes near a corner of the frustum
+	/// may pass when they aren't visible, which only costs a draw.
+	bool isVisible(const AABB &box);
+
+	const Stats &stats() const { return counters; }
+
+private:
+	// Plane normals point into the frustum with the distance in w
+	glm::vec4 planes[6];
+	Stats counters;
+};
+
+#endif // __FRUSTUM_HPP__
@@ -0,0 +1,37 @@
+#ifndef __GL_STATS_HPP__
+#define __GL_STATS_HPP__
+
+#include <cstddef>
+
+/**
+ * Counts of GL work done on the render path. Calls are counted by wrapping them in GL_CALL, draws
+ * in GL_DRAW and copies of data to the GPU in GL_UPLOAD. The counts are reset at the start of each
+ * frame so they show what a frame costs.
+ */
+struct GLStats
+{
+	inline static size_t calls = 0;
+	inline static size_t draws = 0;
+	inline static size_t triangles = 0;
+	inline static size_t uploads = 0;
+	inline static size_t upload_bytes = 0;
+
+	static void reset()
+	{
+		calls = 0;
+		draws = 0;
+		triangles = 0;
+		uploads = 0;
+		upload_bytes = 0;
+	}
+};
+
+#define GL_CALL(call) (GLStats::calls++, call)
+
+// A draw call making the given number of triangles
+#define GL_DRAW(num_triangles, call) (GLStats::draws++, GLStats::triangles += (num_triangles), GL_CALL(call))
+
+// A copy of the given number of bytes into a buffer or texture
+#define GL_UPLOAD(bytes, call) (GLStats::uploads++, GLStats::upload_bytes += (bytes), GL_CALL(call))
+
+#endif // __GL_STATS_HPP__
@@ -0,0 +1,198 @@
+#include <png.h>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+
+#include "image.hpp"
+
+Image::Image(int width, int height, const uint8_t *data) :
+	image_width(width), image_height(height), pixels(data, data + static_cast<size_t>(width) * height * 4)
+{
+}
+
+bool Image::loadPng(const char *filename)
+{
+	const int header_size = 8;
+	unsigned char header[header_size];
+
+	pixels.clear();
+	image_width = image_height = 0;
+
+	// Open the file and check it has a PNG signature
+	FILE *file = fopen(filename, "rb");
+	if (!file)
+	{
+		cerr << "Image could not be opened: " << filename << endl;
+		return false;
+	}
+
+	if (fread(header, 1, header_size, file) != header_size)
+	{
+		cerr << "Failed to read PNG header bytes\n";
+		fclose(file);
+		return false;
+	}
+
+	if (png_sig_cmp(header, 0, header_size))
+	{
+		cerr << "File is not a valid PNG: " << filename << endl;
+		fclose(file);
+		return false;
+	}
+
+	// Create data structures for reading
+	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	if (!png_ptr)
+	{
+		cerr << "Failed to create libPNG header struct\n";
+		fclose(file);
+		return false;
+	}
+
+	png_infop info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr)
+	{
+		png_destroy_read_struct(&png_ptr, nullptr, nullptr);
+		cerr << "Failed to create libPNG info struct\n";
+		fclose(file);
+		return false;
+	}
+
+	// libpng reports errors by jumping back here
+	if (setjmp(png_jmpbuf(png_ptr)))
+	{
+		cerr << "Failed to decode PNG: " << filename << endl;
+		png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+		fclose(file);
+		pixels.clear();
+		return false;
+	}
+
+	png_init_io(png_ptr, file);
+	png_set_sig_bytes(png_ptr, header_size);
+
+	// Read PNG info
+	png_read_info(png_ptr, info_ptr);
+
+	int width      = png_get_image_width(png_ptr, info_ptr);
+	int height     = png_get_image_height(png_ptr, info_ptr);
+	auto color_type = png_get_color_type(png_ptr, info_ptr);
+	auto bit_depth  = png_get_bit_depth(png_ptr, info_ptr);
+
+	// Convert any color type to 8-bit RGBA
+	if (bit_depth == 16)
+	{
+		png_set_strip_16(png_ptr);
+	}
+
+	if (color_type == PNG_COLOR_TYPE_PALETTE)
+	{
+		png_set_palette_to_rgb(png_ptr);
+	}
+
+	if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+	{
+		png_set_expand_gray_1_2_4_to_8(png_ptr);
+	}
+
+	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+	{
+		png_set_tRNS_to_alpha(png_ptr);
+	}
+
+	if (color_type == PNG_COLOR_TYPE_RGB ||
+		color_type == PNG_COLOR_TYPE_GRAY ||
+		color_type == PNG_COLOR_TYPE_PALETTE)
+	{
+		png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
+	}
+
+	if (color_type == PNG_COLOR_TYPE_GRAY ||
+		color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+	{
+		png_set_gray_to_rgb(png_ptr);
+	}
+
+	png_read_update_info(png_ptr, info_ptr);
+
+	// Now read data
+	size_t row_size = png_get_rowbytes(png_ptr, info_ptr);
+	pixels.resize(row_size * height);
+	vector<png_bytep> row_pointers(height);
+	for (int i=0; i<height; i++)
+	{
+		// Need to flip date over vertically as glTexImage2D expected data origin
+		// to be from the bottom left
+		row_pointers[height - i - 1] = &pixels[i * row_size];
+	}
+
+	png_read_image(png_ptr, row_pointers.data());
+
+	// Clean up
+	png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+	fclose(file);
+
+	image_width = width;
+	image_height = height;
+	return true;
+}
+
+Image Image::crop(int x, int y, int width, int height) const
+{
+	Image part;
+	part.image_width = width;
+	part.image_height = height;
+	part.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	for (int row=0; row<height; row++)
+	{
+		const uint8_t *from = &pixels[(static_cast<size_t>(y + row) * image_width + x) * 4];
+		copy(from, from + width * 4, &part.pixels[static_cast<size_t>(row) * width * 4]);
+	}
+
+	return part;
+}
+
+Image Image::halved() const
+{
+	Image half;
+	half.image_width = max(image_width / 2, 1);
+	half.image_height = max(image_height / 2, 1);
+	half.pixels.resize(static_cast<size_t>(half.image_width) * half.image_height * 4);
+
+	// Box filter over the 2x2 pixels under each one, or the 1x2 or 2x1 once a side is down to one
+	int step_x = image_width > 1 ? 2 : 1;
+	int step_y = image_height > 1 ? 2 : 1;
+	for (int y=0; y<half.image_height; y++)
+	{
+		for (int x=0; x<half.image_width; x++)
+		{
+			for (int channel=0; channel<4; channel++)
+			{
+				int sum = 0;
+				for (int dy=0; dy<step_y; dy++)
+				{
+					for (int dx=0; dx<step_x; dx++)
+					{
+						sum += pixels[((y * step_y + dy) * image_width + x * step_x + dx) * 4 + channel];
+					}
+				}
+
+				int count = step_x * step_y;
+				half.pixels[(y * half.image_width + x) * 4 + channel] = static_cast<uint8_t>((sum + count / 2) / count);
+			}
+		}
+	}
+
+	return half;
+}
+
+int Image::numLevels(int width, int height)
+{
+	int levels = 1;
+	for (int size = max(width, height); size > 1; size /= 2)
+	{
+		levels++;
+	}
+	return levels;
+}
@@ -0,0 +1,46 @@
+#ifndef __IMAGE_HPP__
+#define __IMAGE_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * An 8 bit RGBA picture in memory, with rows from the bottom up as glTexImage2D expects. There
+ * are no GL dependencies so tools can decode and prepare textures offline.
+ */
+class Image
+{
+public:
+	Image() {}
+
+	/// Copy of RGBA pixels already in memory.
+	Image(int width, int height, const uint8_t *data);
+
+	/// Decode a PNG of any colour type. False, leaving the image empty, if it can't be read.
+	bool loadPng(const char *filename);
+
+	bool isEmpty() const { return pixels.empty(); }
+	int width() const { return image_width; }
+	int height() const { return image_height; }
+	const uint8_t *data() const { return pixels.data(); }
+	size_t size() const { return pixels.size(); }
+
+	/// Part of the image, x and y being its bottom left pixel. It must lie inside the image.
+	Image crop(int x, int y, int width, int height) const;
+
+	/// Half the size in each direction, at least one pixel, each pixel averaging the ones it covers.
+	Image halved() const;
+
+	/// Levels in a full mip chain down to one pixel.
+	static int numLevels(int width, int height);
+
+private:
+	int image_width = 0;
+	int image_height = 0;
+	vector<uint8_t> pixels;
+};
+
+#endif // __IMAGE_HPP__
@@ -1,7 +1,8 @@
 #include "instance.hpp"
+#include "gl_stats.hpp"
 
-Instance::Instance(WavefrontObj &obj, Texture &tex, GLuint program_id, World &world) :
-	obj(obj), tex(tex), program_id(program_id), world(world)
+Instance::Instance(WavefrontObj &obj, Texture &tex, Program &program, World &world) :
+	obj(obj), tex(tex), program(program), world(world)
 {
 	pos = glm::vec3(0, 0, 0);
 	rot = glm::vec3(0, 0, 0);
@@ -12,39 +13,32 @@ Instance::~Instance()
 {
 }
 
-void Instance::setUniforms()
+glm::mat4 Instance::modelMatrix() const
 {
 	glm::mat4 model = glm::mat4(1);
-	model = glm::translate(pos) *
+	return glm::translate(pos) *
 		glm::rotate(model, rot.x, glm::vec3(1.0, 0.0, 0.0)) *
 		glm::rotate(model, rot.y, glm::vec3(0.0, 1.0, 0.0)) *
 		glm::rotate(model, rot.z, glm::vec3(0.0, 0.0, 1.0)) *
 		glm::scale(model, sca);
-	
-	glm::mat4 mvp = world.camera().projection() * world.camera().view() * model;
-
-	glUseProgram(program_id);
-
-	world.camera().setUniform(program_id, "Camera_Pos");
-	tex.setUniform(program_id, "Tex_Cube");
-	world.light().setUniforms(program_id, "Light_Pos", "Light_Col");
-
-	GLuint mvp_id = glGetUniformLocation(program_id, "MVP");
-	glUniformMatrix4fv(mvp_id, 1, GL_FALSE, &mvp[0][0]);
-
-	GLuint m_id = glGetUniformLocation(program_id, "M");
-	glUniformMatrix4fv(m_id, 1, GL_FALSE, &model[0][0]);
+}
 
-	GLuint v_id = glGetUniformLocation(program_id, "V");
-	glUniformMatrix4fv(v_id, 1, GL_FALSE, &world.camera().view()[0][0]);
+AABB Instance::bounds() const
+{
+	return obj.bounds().transform(modelMatrix());
 }
 
-void Instance::render()
+void Instance::submit(RenderQueue &queue, float depth)
 {
-	tex.bind();
-	obj.bindBuffers();
+	// Camera and light come from the frame uniform block
+	DrawPacket packet;
+	packet.program = &program;
+	packet.texture = &tex;
+	packet.vertex_array_id = obj.vertexArray();
+	packet.model = modelMatrix();
 
-	glDrawArrays(GL_TRIANGLES, 0, obj.numVertices());
-	glBindVertexArray(0);
-}
+	GLsizei count = static_cast<GLsizei>(obj.numIndices());
+	packet.draw = [count]() { GL_DRAW(count / 3, glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)0)); };
 
+	queue.submit(move(packet), depth);
+}
@@ -15,16 +15,29 @@
 
 #include "wavefront_obj.hpp"
 #include "texture.hpp"
+#include "program.hpp"
+#include "render_queue.hpp"
 #include "world.hpp"
+#include "frustum.hpp"
 
 class Instance
 {
 public:
-	Instance(WavefrontObj &obj, Texture &tex, GLuint program_id, World &world);
+	Instance(WavefrontObj &obj, Texture &tex, Program &program, World &world);
 	virtual ~Instance();
 
-	void setUniforms();
-	void render();
+	// World space box around the object, for culling
+	AABB bounds() const;
+
+	// Queue a single draw, depth being the distance from the camera. Many copies of the same
+	// object are better drawn through InstanceRenderer.
+	void submit(RenderQueue &queue, float depth);
+
+	// Model matrix from the position, rotation and scale
+	glm::mat4 modelMatrix() const;
+
+	WavefrontObj &object() { return obj; }
+	Texture &texture() { return tex; }
 
 	glm::vec3 &position() { return pos; }
 	glm::vec3 &rotation() { return rot; }
@@ -37,7 +50,7 @@ private:
 
 	WavefrontObj &obj;
 	Texture &tex;
-	GLuint program_id;
+	Program &program;
 	World &world;
 };
 
@@ -0,0 +1,107 @@
+#include "instance_renderer.hpp"
+#include "gl_stats.hpp"
+
+// First of the four vec4 attribute locations taken by the per-instance model matrix
+constexpr GLuint ModelLocation = 5;
+
+InstanceRenderer::~InstanceRenderer()
+{
+	for (auto &entry : groups)
+	{
+		glDeleteVertexArrays(1, &entry.second.vertex_array_id);
+		glDeleteBuffers(1, &entry.second.instance_buffer);
+	}
+}
+
+void InstanceRenderer::createGroup(Group &group)
+{
+	glGenVertexArrays(1, &group.vertex_array_id);
+	glBindVertexArray(group.vertex_array_id);
+
+	// Per-vertex data comes from the object's own buffers
+	group.obj->setupAttributes();
+
+	glGenBuffers(1, &group.instance_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, group.instance_buffer);
+
+	// A mat4 attribute is four vec4 columns, each advancing once per instance
+	for (GLuint column=0; column<4; column++)
+	{
+		glEnableVertexAttribArray(ModelLocation + column);
+		glVertexAttribPointer(
+			ModelLocation + column,
+			4,
+			GL_FLOAT,
+			GL_FALSE,
+			sizeof(glm::mat4),
+			(void*)(column * sizeof(glm::vec4))
+			);
+		glVertexAttribDivisor(ModelLocation + column, 1);
+	}
+
+	glBindVertexArray(0);
+}
+
+void InstanceRenderer::add(Instance &instance, const glm::mat4 &model)
+{
+	// Instances of the same kind usually come one after another, so skip the lookup for those
+	if (!last_group || last_group->obj != &instance.object() || last_group->texture != &instance.texture())
+	{
+		Group &group = groups[make_pair(&instance.object(), &instance.texture())];
+		if (!group.obj)
+		{
+			group.obj = &instance.object();
+			group.texture = &instance.texture();
+			createGroup(group);
+		}
+		last_group = &group;
+	}
+
+	last_group->models.push_back(model);
+}
+
+void InstanceRenderer::submit(RenderQueue &queue, Program &program)
+{
+	last_groups = 0;
+	last_instances = 0;
+
+	for (auto &entry : groups)
+	{
+		Group &group = entry.second;
+		if (group.models.empty())
+		{
+			continue;
+		}
+
+		last_groups++;
+		last_instances += group.models.size();
+
+		DrawPacket packet;
+		packet.program = &program;
+		packet.texture = group.texture;
+		packet.vertex_array_id = group.vertex_array_id;
+		packet.flags = DrawPacket::FlagInstanced;
+		packet.draw = [this, &group]() { drawGroup(group); };
+
+		queue.submit(move(packet), 0.0f);
+	}
+}
+
+void InstanceRenderer::drawGroup(Group &group)
+{
+	// Orphan the old contents so the upload doesn't wait for last frame's draw
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, group.instance_buffer));
+	if (group.models.size() > group.capacity)
+	{
+		group.capacity = max(group.models.size(), group.capacity * 2);
+	}
+	GL_CALL(glBufferData(GL_ARRAY_BUFFER, group.capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW));
+	GL_UPLOAD(group.models.size() * sizeof(glm::mat4),
+			  glBufferSubData(GL_ARRAY_BUFFER, 0, group.models.size() * sizeof(glm::mat4), group.models.data()));
+
+	GL_DRAW(group.obj->numIndices() / 3 * group.models.size(),
+			glDrawElementsInstanced(GL_TRIANGLES, group.obj->numIndices(), GL_UNSIGNED_INT, (void*)0,
+									static_cast<GLsizei>(group.models.size())));
+
+	group.models.clear();
+}
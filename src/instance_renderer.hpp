@@ -0,0 +1,69 @@
+#ifndef __INSTANCE_RENDERER_HPP__
+#define __INSTANCE_RENDERER_HPP__
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstddef>
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "instance.hpp"
+#include "wavefront_obj.hpp"
+#include "texture.hpp"
+#include "program.hpp"
+#include "render_queue.hpp"
+
+using namespace std;
+
+/**
+ * Draws Instances with hardware instancing. Instances are grouped by object and texture, and
+ * each group's model matrices are uploaded into a per-instance attribute buffer once a frame
+ * and drawn with a single glDrawElementsInstanced call.
+ */
+class InstanceRenderer
+{
+public:
+	InstanceRenderer() {}
+	~InstanceRenderer();
+
+	InstanceRenderer(const InstanceRenderer &) = delete;
+	InstanceRenderer &operator=(const InstanceRenderer &) = delete;
+
+	/// Queue an instance for the next submit() with the model matrix it is to be drawn with.
+	void add(Instance &instance, const glm::mat4 &model);
+
+	/// Hand everything added since the last call to the render queue, one draw per group.
+	void submit(RenderQueue &queue, Program &program);
+
+	size_t numGroups() const { return last_groups; }
+	size_t numInstances() const { return last_instances; }
+
+private:
+	struct Group
+	{
+		WavefrontObj *obj = nullptr;
+		Texture *texture = nullptr;
+		GLuint vertex_array_id = 0;
+		GLuint instance_buffer = 0;
+		size_t capacity = 0;
+		vector<glm::mat4> models;
+	};
+
+	void createGroup(Group &group);
+	void drawGroup(Group &group);
+
+	// Groups are kept between frames so their vertex arrays and buffers can be reused
+	map<pair<WavefrontObj*, Texture*>, Group> groups;
+	Group *last_group = nullptr;
+
+	size_t last_groups = 0;
+	size_t last_instances = 0;
+};
+
+#endif // __INSTANCE_RENDERER_HPP__
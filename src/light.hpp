@@ -19,8 +19,6 @@ public:
 	Light(glm::vec3 pos, glm::vec3 col);
 	virtual ~Light();
 
-	void setUniforms(GLuint program_id, const char *pos_name, const char *col_name);
-
 	glm::vec3 &position() { return pos; }
 	glm::vec3 &color() { return col; }
 
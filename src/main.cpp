@@ -4,6 +4,9 @@
 #include <chrono>
 #include <vector>
 #include <random>
+#include <algorithm>
+#include <memory>
+#include <fstream>
 
 // Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
 #include <GL/glew.h>
@@ -25,13 +28,33 @@
 #include "texture.hpp"
 #include "light.hpp"
 #include "instance.hpp"
+#include "instance_renderer.hpp"
 #include "world.hpp"
 #include "blockinstance.hpp"
+#include "block_mesher.hpp"
+#include "chunk_manager.hpp"
+#include "region_store.hpp"
+#include "asset_pack.hpp"
+#include "texture_loader.hpp"
+#include "chunk_geometry.hpp"
+#include "frustum.hpp"
+#include "occlusion_buffer.hpp"
+#include "program.hpp"
+#include "frame_uniforms.hpp"
+#include "gl_stats.hpp"
+#include "render_queue.hpp"
+#include "profiler.hpp"
+#include "profiler_hud.hpp"
+#include "camera_path.hpp"
 
 #include "ant_attack.hpp"
 
 using namespace std;
 
+// Simulated time between benchmark frames, and between keyframes of a recorded path
+constexpr float BenchmarkStep = 1.0f / 60.0f;
+constexpr float RecordInterval = 0.1f;
+
 double xpos = 0.0;
 double ypos = 0.0;
 
@@ -114,12 +137,166 @@ void handleMovement(Window &win, glm::vec3 &move, glm::vec3 &rotate, float elaps
 	ypos = new_ypos;
 }
 
+void loadAntAttackChunk(const ChunkCoord &coord, BlockInstance &block)
+{
+	constexpr int map_blocks_x = ant_attack_size / BLOCK_WIDTH;
+	constexpr int map_blocks_z = ant_attack_size / BLOCK_DEPTH;
+
+	// Nothing outside of the map
+	if (coord.y != 0 || coord.x < 0 || coord.x >= map_blocks_x || coord.z < 0 || coord.z >= map_blocks_z)
+	{
+		return;
+	}
+
+	int bigx = coord.x * BLOCK_WIDTH;
+	int bigz = coord.z * BLOCK_DEPTH;
+
+	for (int z=0; z<BLOCK_DEPTH; z++)
+	{
+		for (int x=0; x<BLOCK_WIDTH; x++)
+		{
+			int idx = ((bigz + z) * ant_attack_size) + (bigx + x);
+			for (int y = 0; y < 6; y++)
+			{
+				if ((map_data[idx] & (0x1 << y)) != 0)
+				{
+					block.setBit(x, y + 1, z, BlockInstance::Block::Stone);
+				}
+			}
+
+			// Add floor
+			block.setBit(x, 0, z, BlockInstance::Block::Topsoil);
+		}
+	}
+}
+
+void reportBlocks(ChunkManager &chunks, ChunkGeometry &geometry, bool verbose)
+{
+	size_t faces_total = 0;
+	size_t faces_emitted = 0;
+	size_t mesh_vertices = 0;
+	size_t mesh_bytes = 0;
+	size_t voxel_bytes = 0;
+	size_t uniform_blocks = 0;
+	for (auto &entry : chunks.chunks())
+	{
+		const ChunkCoord &coord = entry.first;
+		BlockInstance &block = *entry.second;
+
+		faces_total += block.numFacesTotal();
+		faces_emitted += block.numFaces();
+		mesh_vertices += block.numVertices();
+		mesh_bytes += block.meshBytes();
+		voxel_bytes += block.memoryUsage();
+		uniform_blocks += block.isUniform();
+
+		if (verbose)
+		{
+			cout << "Block (" << coord.x << ", " << coord.y << ", " << coord.z << "): " << block.numFacesTotal() << " faces, " <<
+				block.numFaces() << " emitted\n";
+		}
+	}
+
+	size_t num_blocks = chunks.chunks().size();
+	cout << "Number of object blocks in scene: " << num_blocks << endl;
+	cout << "Number of faces in scene: " << faces_emitted << " of " << faces_total << endl;
+	cout << "Block vertex memory: " << mesh_bytes / 1024 << " KB (" << mesh_vertices * BlockInstance::FloatVertexSize / 1024 <<
+		" KB as float vertices, " << mesh_vertices * sizeof(BlockInstance::PackedVertex) / 1024 << " KB packed)\n";
+	cout << "Block voxel memory: " << voxel_bytes / 1024 << " KB, " << voxel_bytes / max<size_t>(num_blocks, 1) <<
+		" bytes per block, " << uniform_blocks << " uniform blocks\n";
+	cout << "Shared block geometry: " << geometry.verticesUsed() * sizeof(BlockInstance::PackedVertex) / 1024 << " KB used of " <<
+		geometry.capacity() * sizeof(BlockInstance::PackedVertex) / 1024 << " KB, drawn with " <<
+		(geometry.usesIndirect() ? "glMultiDrawElementsIndirect" : "glMultiDrawElementsBaseVertex") << endl;
+}
+
+/// Quotes text as a JSON string, escaping the characters JSON doesn't allow as they are
+string jsonString(const string &text)
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			quoted += '\\';
+			quoted += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			quoted += "\\u00";
+			quoted += hex_digits[(c >> 4) & 0xf];
+			quoted += hex_digits[c & 0xf];
+		}
+		else
+		{
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+void reportBenchmark(ostream &out, const Options &options, const Profiler &profiler, const char *renderer,
+					 float first_frame_ms, float ready_ms)
+{
+	auto write_summary = [&out](const char *name, const Profiler::Summary &summary)
+	{
+		out << "  \"" << name << "\": { \"mean\": " << summary.mean << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95 <<
+			", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << " },\n";
+	};
+
+	vector<float> triangles;
+	vector<float> draws;
+	for (const auto &counters : profiler.counters())
+	{
+		triangles.push_back(static_cast<float>(counters.triangles));
+		draws.push_back(static_cast<float>(counters.draws));
+	}
+
+	out << "{\n";
+	out << "  \"path\": " << jsonString(options.benchmark()) << ",\n";
+	out << "  \"renderer\": " << jsonString(renderer ? renderer : "unknown") << ",\n";
+	out << "  \"width\": " << options.width() << ",\n";
+	out << "  \"height\": " << options.height() << ",\n";
+	out << "  \"timestep_ms\": " << 1000.0f * BenchmarkStep << ",\n";
+	out << "  \"first_frame_ms\": " << first_frame_ms << ",\n";
+	out << "  \"ready_ms\": " << ready_ms << ",\n";
+	write_summary("frame_ms", Profiler::summarise(profiler.frames()));
+	write_summary("gpu_ms", Profiler::summarise(profiler.gpuFrames()));
+	write_summary("draws_per_frame", Profiler::summarise(draws));
+	write_summary("triangles_per_frame", Profiler::summarise(triangles));
+	out << "  \"frames\": " << profiler.numFrames() << "\n";
+	out << "}\n";
+}
+
 int main(int argc, char *argv[])
 {
+	auto start_time = chrono::steady_clock::now();
+
 	Options options(argc, argv);
 	int width = options.width();
 	int height = options.height();
 
+	// A benchmark flies a path at a fixed rate rather than following the keyboard, with nothing on screen
+	bool benchmark = !options.benchmark().empty();
+
+	// Progress messages go to standard error in a benchmark, so standard output carries only the report
+	streambuf *report_output = cout.rdbuf();
+	if (benchmark)
+	{
+		cout.rdbuf(cerr.rdbuf());
+	}
+
+	CameraPath benchmark_path;
+	if (benchmark && !benchmark_path.load(options.benchmark()))
+	{
+		return -1;
+	}
+
+	if (benchmark)
+	{
+		Window::useNullPlatform();
+	}
+
 	// Initialise GLFW
 	if( !glfwInit() )
 	{
@@ -127,20 +304,36 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	Window win = Window(width, height, "Orbis");
+	Window win = Window(width, height, "Orbis", benchmark);
 
 	win.getMousePos(xpos, ypos);
 
 	glewExperimental = true; // Needed in core profile
-	if (glewInit() != GLEW_OK)
+	GLenum glew_status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLEW looks for GLX, which an EGL context doesn't have, but it has still loaded everything
+	if (benchmark && glew_status == GLEW_ERROR_NO_GLX_DISPLAY)
+	{
+		glew_status = GLEW_OK;
+	}
+#endif
+	if (glew_status != GLEW_OK)
 	{
 		cerr << "Failed to initialize GLEW\n";
 		return -1;
 	}
 
+	// Assets come from the pack when one is given, otherwise from the loose files
+	auto asset_start = chrono::steady_clock::now();
+	unique_ptr<AssetPack> pack;
+	if (!options.pack().empty())
+	{
+		pack = make_unique<AssetPack>(options.pack());
+	}
+
 	// Create and compile our GLSL program from the shaders
-	GLuint program_id = load_shaders( "res/vertex_shader.glsl", "res/fragment_shader.glsl" );
-	if (!program_id)
+	Program program("res/vertex_shader.glsl", "res/fragment_shader.glsl", pack.get());
+	if (!program.isValid())
 	{
 		cerr << "Error detected when loading shaders. Aborting.\n";
 		abort();
@@ -159,78 +352,431 @@ int main(int argc, char *argv[])
 	Camera camera = Camera(glm::vec3(0, 0, 64),
 						   glm::vec3(glm::radians(0.0f), glm::radians(0.0f), 0.0f),
 						   glm::radians(45.0f),
-						   static_cast<float>(width) / static_cast<float>(height));
+						   static_cast<float>(width) / static_cast<float>(height),
+						   static_cast<float>((options.radius() + 1) * BLOCK_WIDTH));
 
 	World world = World(camera, light);
 
+	// Camera and light are uploaded once a frame rather than for every object
+	FrameUniforms frame_uniforms;
+	program.bindUniformBlock("Frame", FrameUniforms::Binding);
+
 	// Set up objects to render
-	Texture block_texture = Texture("res/blockinstance.png", 1, false);
-	vector<BlockInstance> objects;
-	for (int bigz=0; bigz<128; bigz+=BLOCK_DEPTH)
+	// PNGs are decoded in the background, showing a placeholder until the render loop uploads them
+	TextureLoader texture_loader;
+	Texture block_texture = Texture("res/blockinstance.png", 1, false, pack.get(), &texture_loader);
+	block_texture.setUniform(program, "Tex_Cube");
+
+	// Block faces repeat whole materials, cut from the same atlas into the layers of an array
+	vector<int> material_cells(begin(BlockInstance::materialCells), end(BlockInstance::materialCells));
+	Texture block_materials("res/blockinstance.png", 16, material_cells, 3, false, pack.get(), &texture_loader);
+	block_materials.setUniform(program, "Block_Materials");
+	chrono::duration<float, milli> asset_time = chrono::steady_clock::now() - asset_start;
+	BlockInstance::MeshMode mesh_mode = BlockInstance::MeshGreedy;
+	if (options.mesh() == "naive")
 	{
-		for (int bigx=0; bigx<128; bigx+=BLOCK_WIDTH)
-		{
-			BlockInstance block = BlockInstance(block_texture, program_id, world);
-			block.position().x = static_cast<float>(bigx) - 64.0f;
-			block.position().y = -10.f;
-			block.position().z = static_cast<float>(bigz) - 64.0f;
+		mesh_mode = BlockInstance::MeshNaive;
+	}
+	else if (options.mesh() == "culled")
+	{
+		mesh_mode = BlockInstance::MeshCulled;
+	}
 
-			for (int z=0; z<BLOCK_DEPTH; z++)
-			{
-				for (int x=0; x<BLOCK_WIDTH; x++)
-				{
-					int idx = ((bigz + z) * 128) + (bigx + x);
-					for (int y = 0; y < 6; y++)
-					{
-						if ((map_data[idx] & (0x1 << y)) != 0)
-						{
-							block.setBit(x, y + 1, z, BlockInstance::Block::Stone);
-						}
-					}
-
-					// Add floor
-					block.setBit(x, 0, z, BlockInstance::Block::Topsoil);
-				}
-			}
+	BlockInstance::VertexFormat vertex_format = BlockInstance::FormatPacked;
+	if (options.vertices() == "float")
+	{
+		vertex_format = BlockInstance::FormatFloat;
+	}
 
-			block.generateBlock();
-			objects.push_back(block);
+	// Mesh in the background, the render loop uploads blocks as they are finished
+	BlockMesher mesher;
+	mesher.setViewer(camera.position());
+
+	// Packed block meshes share one vertex buffer and are drawn together
+	ChunkGeometry chunk_geometry;
+
+	// Stream in the map around the camera, from a saved world when one is given. Changed blocks
+	// are written back to it.
+	unique_ptr<RegionStore> region_store;
+	ChunkManager::ChunkSource source = loadAntAttackChunk;
+	if (!options.world().empty())
+	{
+		region_store = make_unique<RegionStore>(options.world());
+		source = [&region_store](const ChunkCoord &coord, BlockInstance &block) { region_store->load(coord, block); };
+	}
+
+	ChunkManager chunks(block_materials, program, world, mesher, source);
+	if (region_store)
+	{
+		chunks.setChunkSink([&region_store](const ChunkCoord &coord, const BlockInstance &block) { return region_store->save(coord, block); });
+	}
+	glm::vec3 map_origin(-ant_attack_size / 2, -10, -ant_attack_size / 2);
+	chunks.setOrigin(map_origin);
+	chunks.setRadius(options.radius());
+	chunks.setBackgroundLoading();
+	chunks.setPrefetchTime(options.prefetch());
+	chunks.setLodDistance(options.lod());
+	chunks.setMeshMode(mesh_mode);
+	chunks.setVertexFormat(vertex_format);
+	if (vertex_format == BlockInstance::FormatPacked)
+	{
+		chunks.setGeometry(&chunk_geometry);
+	}
+
+	// Optional copies of an object scattered across the map, turning in place and drawn instanced
+	unique_ptr<WavefrontObj> prop;
+	vector<Instance> props;
+	vector<float> prop_spin;
+	InstanceRenderer instance_renderer;
+	if (!options.obj().empty())
+	{
+		asset_start = chrono::steady_clock::now();
+		prop = make_unique<WavefrontObj>(options.obj().c_str(), pack.get());
+		asset_time += chrono::steady_clock::now() - asset_start;
+
+		mt19937 rng(1);
+		uniform_real_distribution<float> across(-ant_attack_size / 2.0f, ant_attack_size / 2.0f);
+		uniform_real_distribution<float> spin(-2.0f, 2.0f);
+
+		props.reserve(options.instances());
+		for (int i=0; i<options.instances(); i++)
+		{
+			props.emplace_back(*prop, block_texture, program, world);
+			props.back().position() = glm::vec3(across(rng), -9.0f, across(rng));
+			prop_spin.push_back(spin(rng));
 		}
 	}
 
-	cout << "Number of object blocks in scene: " << objects.size() << endl;
+	cout << "Assets loaded in " << asset_time.count() << " ms from " << (pack && pack->isValid() ? options.pack() : "loose files") <<
+		", decoding " << texture_loader.pending() << " textures on " << texture_loader.numThreads() << " threads\n";
+	cout << "Streaming blocks within " << options.radius() << " blocks of the camera, meshing on " <<
+		mesher.numThreads() << " threads\n";
+
+	// Skip blocks that are outside of the view or hidden behind the nearest blocks
+	Frustum frustum;
+	OcclusionBuffer occlusion;
+	vector<pair<float, BlockInstance*>> visible_blocks;
+
+	// Draws are queued, sorted by state and then made in one go
+	RenderQueue render_queue;
+	size_t frame_gl_calls = 0;
+	size_t frame_faces = 0;
+
+	bool first_frame = true;
+	bool meshing = true;
+	float worst_frame_time = 0.0f;
+
+	// Off unless asked for, F3 switches it and its overlay on and off. A benchmark uses it for its
+	// timings, switching it on once everything around the start of the path is loaded.
+	Profiler profiler;
+	unique_ptr<ProfilerHud> profiler_hud;
+	profiler.setEnabled(!options.profile().empty() && !benchmark);
+	bool profile_key_down = false;
+
+	int benchmark_frame = 0;
+	int benchmark_frames = options.frames() > 0 ? options.frames() : static_cast<int>(benchmark_path.duration() / BenchmarkStep) + 1;
+	float first_frame_ms = 0.0f;
+	float ready_ms = 0.0f;
+
+	// The route flown, for playing back with --benchmark
+	bool record = !options.record().empty();
+	CameraPath recording;
+	float record_time = 0.0f;
+
+	// Voxels changed by --edits, within a couple of blocks of the camera and in the layers of the map.
+	// They start once the blocks around the camera are meshed, so a benchmark still knows when to start.
+	mt19937 edit_rng(2);
+	uniform_int_distribution<int> edit_across(-2 * BLOCK_WIDTH, 2 * BLOCK_WIDTH);
+	uniform_int_distribution<int> edit_height(0, 7);
 
 	// Render loop
 	do
 	{
+		profiler.beginFrame();
+		GLStats::reset();
+
 		// Get time taken to draw the frame
 		tp2 = chrono::system_clock::now();
 		chrono::duration<float> elapsed_time = tp2 - tp1;
 		tp1 = tp2;
 
-		char title[256];
-		snprintf(title, 256, "Orbis - %3.1f fps", 1.0f / elapsed_time.count());
+		// Every run sees the same frames however fast the machine is
+		if (benchmark)
+		{
+			elapsed_time = chrono::duration<float>(BenchmarkStep);
+		}
+
+		const ChunkManager::Stats &chunk_stats = chunks.stats();
+		const Frustum::Stats &cull_stats = frustum.stats();
+		const OcclusionBuffer::Stats &occlusion_stats = occlusion.stats();
+		const RenderQueue::Stats &queue_stats = render_queue.stats();
+
+		size_t reads = chunk_stats.prefetched + chunk_stats.demand;
+		float prefetch_hits = reads > 0 ? 100.0f * chunk_stats.prefetched / reads : 0.0f;
+
+		char title[448];
+		snprintf(title, 448, "Orbis - %3.1f fps - blocks %zu resident, %zu loading, %zu evicted, %zu meshed - io %zu queued, %.0f%% prefetched, "
+				 "%zu stalls - %zu of %zu in view, %zu occluded (%.2f ms) - %zu faces - %zu GL calls, %zu state changes skipped",
+				 1.0f / elapsed_time.count(), chunk_stats.resident, chunk_stats.loading, chunk_stats.evicted, chunk_stats.meshed,
+				 chunk_stats.io_queued, prefetch_hits, chunk_stats.stalls, cull_stats.visible, cull_stats.tested, occlusion_stats.occluded,
+				 occlusion_stats.raster_ms + occlusion_stats.test_ms, frame_faces, frame_gl_calls, queue_stats.skipped);
 		win.setTitle(title);
 
 		// Handle movement of camera
 		glm::vec3 rotate(0, 0, 0);
 		glm::vec3 move(0, 0, 0);
 
-		handleMovement(win, move, rotate, elapsed_time.count());
-		camera.move(move, rotate);
+		if (benchmark)
+		{
+			glm::vec3 position;
+			glm::vec3 rotation;
+			benchmark_path.sample(benchmark_frame * BenchmarkStep, position, rotation);
+			camera.setPose(position, rotation);
+		}
+		else
+		{
+			handleMovement(win, move, rotate, elapsed_time.count());
+			camera.move(move, rotate);
+		}
+
+		if (record)
+		{
+			// Keyframes a tenth of a second apart follow the route closely once splined
+			if (recording.empty() || record_time - recording.duration() >= RecordInterval)
+			{
+				recording.add(record_time, camera.position(), camera.rotation());
+			}
+			record_time += elapsed_time.count();
+		}
+
+		// Load blocks coming into range, reading ahead in the direction the camera is moving, and swap
+		// in any finished meshes, keeping the upload cost within a couple of milliseconds
+		{
+			PROFILE_SCOPE("Update");
+			glm::vec3 velocity = camera.lastMove() / max(elapsed_time.count(), 0.001f);
+			if (options.edits() > 0 && !meshing)
+			{
+				PROFILE_SCOPE("Edits");
+				glm::vec3 centre = glm::floor(camera.position());
+				for (int i=0; i<options.edits(); i++)
+				{
+					glm::vec3 voxel(centre.x + edit_across(edit_rng), map_origin.y + edit_height(edit_rng), centre.z + edit_across(edit_rng));
+					bool solid = chunks.voxel(voxel) != BlockInstance::Block::Empty;
+					chunks.setVoxel(voxel, solid ? BlockInstance::Block::Empty : BlockInstance::Block::Stone);
+				}
+			}
+			{
+				PROFILE_SCOPE("Chunks");
+				chunks.update(camera.position(), velocity);
+			}
+
+			PROFILE_GPU_SCOPE("Uploads");
+			mesher.setViewer(camera.position());
+			mesher.upload(2.0f);
+			texture_loader.upload(1.0f);
+		}
+
+		{
+			PROFILE_GPU_SCOPE("Clear");
+			glClearColor(0.3f, 0.6f, 0.9f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			frame_uniforms.update(camera, light);
+		}
+
+		bool occlusion_culling = options.occluders() > 0;
+		{
+			PROFILE_SCOPE("Cull");
+			glm::mat4 view_projection = camera.projection() * camera.view();
+			frustum.update(view_projection);
+
+			visible_blocks.clear();
+			for (auto &entry : chunks.chunks())
+			{
+				BlockInstance &object = *entry.second;
+				if (object.hasMesh() && frustum.isVisible(object.bounds()))
+				{
+					glm::vec3 offset = object.centre() - camera.position();
+					visible_blocks.emplace_back(glm::dot(offset, offset), &object);
+				}
+			}
+
+			// The nearest blocks in view hide the most, so they are the ones drawn as occluders
+			if (occlusion_culling)
+			{
+				sort(visible_blocks.begin(), visible_blocks.end(),
+					 [](const pair<float, BlockInstance*> &a, const pair<float, BlockInstance*> &b) { return a.first < b.first; });
 
-		glClearColor(0.3f, 0.6f, 0.9f, 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				PROFILE_SCOPE("Occlusion");
+				occlusion.begin(view_projection);
+				for (size_t i=0; i<visible_blocks.size() && i<static_cast<size_t>(options.occluders()); i++)
+				{
+					BlockInstance &object = *visible_blocks[i].second;
+					occlusion.addOccluders(object.occluders(), object.modelMatrix());
+				}
+				occlusion.rasterize();
+			}
+		}
 
-		for (auto &object : objects)
 		{
-			object.setUniforms();
-			object.render();
+			PROFILE_SCOPE("Submit");
+			frame_faces = 0;
+			for (auto &entry : visible_blocks)
+			{
+				BlockInstance &object = *entry.second;
+				if (occlusion_culling && !occlusion.isVisible(object.bounds()))
+				{
+					continue;
+				}
+
+				// Distant blocks swap to a coarser mesh, all of which are already uploaded
+				float distance = sqrt(entry.first);
+				object.setLod(chunks.levelOfDetail(distance));
+				frame_faces += object.numLodFaces();
+
+				if (object.geometrySlot() >= 0)
+				{
+					chunk_geometry.add(object.geometrySlot());
+					continue;
+				}
+
+				object.submit(render_queue, distance);
+			}
+
+			chunk_geometry.submit(render_queue, program, block_materials);
+
+			for (size_t i=0; i<props.size(); i++)
+			{
+				Instance &object = props[i];
+				object.rotation().y += prop_spin[i] * elapsed_time.count();
+
+				glm::mat4 model = object.modelMatrix();
+				if (frustum.isVisible(object.object().bounds().transform(model)))
+				{
+					instance_renderer.add(object, model);
+				}
+			}
+
+			instance_renderer.submit(render_queue, program);
 		}
 
-		win.swapBuffers();
+		{
+			PROFILE_GPU_SCOPE("Draw");
+			render_queue.flush();
+		}
+
+		frame_gl_calls = GLStats::calls;
+
+		Profiler::Counters counters;
+		counters.draws = GLStats::draws;
+		counters.triangles = GLStats::triangles;
+		counters.state_changes = render_queue.stats().changes;
+		counters.uploads = GLStats::uploads;
+		counters.upload_bytes = GLStats::upload_bytes;
+
+		if (profiler.isEnabled() && !benchmark)
+		{
+			PROFILE_GPU_SCOPE("HUD");
+			if (!profiler_hud)
+			{
+				profiler_hud = make_unique<ProfilerHud>(pack.get());
+			}
+			profiler_hud->draw(profiler, width, height);
+		}
+
+		{
+			PROFILE_SCOPE("Swap");
+
+			// Include the GPU's work in the frame time, all of it with a software renderer
+			if (benchmark)
+			{
+				glFinish();
+			}
+			win.swapBuffers();
+		}
+		profiler.endFrame(counters);
+
+		if (benchmark && profiler.isEnabled())
+		{
+			benchmark_frame++;
+		}
+
+		bool profile_key = win.isKeyPressed(GLFW_KEY_F3);
+		if (profile_key && !profile_key_down)
+		{
+			profiler.setEnabled(!profiler.isEnabled());
+		}
+		profile_key_down = profile_key;
+
+		if (first_frame)
+		{
+			chrono::duration<float, milli> startup = chrono::steady_clock::now() - start_time;
+			cout << "Time to first frame: " << startup.count() << " ms\n";
+			first_frame_ms = startup.count();
+			first_frame = false;
+		}
+		else if (meshing)
+		{
+			worst_frame_time = max(worst_frame_time, elapsed_time.count());
+
+			if (chunks.stats().loading == 0)
+			{
+				chrono::duration<float, milli> startup = chrono::steady_clock::now() - start_time;
+				cout << "All blocks meshed after " << startup.count() << " ms, worst frame time while meshing " <<
+					worst_frame_time * 1000.0f << " ms\n";
+				reportBlocks(chunks, chunk_geometry, options.verbose());
+				ready_ms = startup.count();
+				meshing = false;
+
+				if (benchmark)
+				{
+					cout << "Benchmarking " << benchmark_frames << " frames along " << options.benchmark() << endl;
+					profiler.setEnabled(true);
+				}
+			}
+		}
+	}
+	while (!win.isKeyPressed(GLFW_KEY_ESCAPE) && !(benchmark && benchmark_frame >= benchmark_frames));
+
+	if (benchmark)
+	{
+		// Collects the last GPU timings
+		profiler.setEnabled(false);
+
+		const char *renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+		if (options.report().empty())
+		{
+			ostream report(report_output);
+			reportBenchmark(report, options, profiler, renderer, first_frame_ms, ready_ms);
+			report.flush();
+		}
+		else
+		{
+			ofstream report(options.report());
+			reportBenchmark(report, options, profiler, renderer, first_frame_ms, ready_ms);
+			if (!report)
+			{
+				cerr << "Unable to write benchmark report " << options.report() << endl;
+			}
+		}
+	}
+
+	if (record)
+	{
+		recording.add(record_time, camera.position(), camera.rotation());
+		if (recording.save(options.record()))
+		{
+			cout << "Recorded " << recording.duration() << " seconds of camera path to " << options.record() << endl;
+		}
+	}
+
+	if (profiler.numFrames() > 0 && (!benchmark || !options.profile().empty()))
+	{
+		string profile_file = options.profile().empty() ? "orbis_profile.csv" : options.profile();
+		if (profiler.writeCsv(profile_file))
+		{
+			cout << "Profile of " << profiler.numFrames() << " frames written to " << profile_file << endl;
+		}
 	}
-	while (!win.isKeyPressed(GLFW_KEY_ESCAPE));
 
 	return 0;
 }
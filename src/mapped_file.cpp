@@ -0,0 +1,55 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mapped_file.hpp"
+
+MappedFile::MappedFile(const string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		cerr << "Unable to open " << path << ": " << strerror(errno) << endl;
+		return;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		cerr << "Unable to read the size of " << path << ": " << strerror(errno) << endl;
+		close(fd);
+		return;
+	}
+
+	length = static_cast<size_t>(info.st_size);
+	if (length > 0)
+	{
+		void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			cerr << "Unable to map " << path << ": " << strerror(errno) << endl;
+			close(fd);
+			length = 0;
+			return;
+		}
+
+		// Read front to back, so let the kernel read ahead
+		madvise(mapped, length, MADV_SEQUENTIAL);
+		mapping = static_cast<char*>(mapped);
+	}
+
+	// The mapping holds its own reference to the file
+	close(fd);
+	valid = true;
+}
+
+MappedFile::~MappedFile()
+{
+	if (mapping)
+	{
+		munmap(mapping, length);
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * A whole file mapped read only into memory, for parsing large files without copying them.
+ */
+class MappedFile
+{
+public:
+	MappedFile(const string &path);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	/// False if the file couldn't be opened. An empty file is valid but has no data.
+	bool isValid() const { return valid; }
+
+	const char *data() const { return mapping; }
+	size_t size() const { return length; }
+
+private:
+	bool valid = false;
+	char *mapping = nullptr;
+	size_t length = 0;
+};
+
+#endif // __MAPPED_FILE_HPP__
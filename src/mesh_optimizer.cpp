@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "mesh_optimizer.hpp"
+
+float MeshOptimizer::vertexScore(int cache_position, uint32_t remaining_triangles)
+{
+	if (remaining_triangles == 0)
+	{
+		return -1.0f;
+	}
+
+	// The three vertices of the last triangle score the same so that it doesn't matter which
+	// way round it was added, after that the score falls away towards the end of the cache
+	float score = 0.0f;
+	if (cache_position >= 0 && cache_position < 3)
+	{
+		score = 0.75f;
+	}
+	else if (cache_position >= 3)
+	{
+		score = powf(1.0f - (cache_position - 3) / static_cast<float>(CacheSize - 3), 1.5f);
+	}
+
+	// Vertices with few triangles left are finished off first, so they don't have to come back
+	return score + 2.0f / sqrtf(static_cast<float>(remaining_triangles));
+}
+
+void MeshOptimizer::optimizeVertexCache(vector<uint32_t> &indices, size_t num_vertices)
+{
+	size_t num_triangles = indices.size() / 3;
+	if (num_triangles == 0)
+	{
+		return;
+	}
+
+	// Triangles using each vertex
+	vector<uint32_t> offsets(num_vertices + 1, 0);
+	for (uint32_t index : indices)
+	{
+		offsets[index + 1]++;
+	}
+	for (size_t vertex=0; vertex<num_vertices; vertex++)
+	{
+		offsets[vertex + 1] += offsets[vertex];
+	}
+
+	vector<uint32_t> remaining(num_vertices);
+	vector<uint32_t> triangles(indices.size());
+	for (size_t vertex=0; vertex<num_vertices; vertex++)
+	{
+		remaining[vertex] = offsets[vertex + 1] - offsets[vertex];
+	}
+	{
+		vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+		for (size_t i=0; i<indices.size(); i++)
+		{
+			triangles[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	vector<int> cache_position(num_vertices, -1);
+	vector<float> vertex_scores(num_vertices);
+	for (size_t vertex=0; vertex<num_vertices; vertex++)
+	{
+		vertex_scores[vertex] = vertexScore(-1, remaining[vertex]);
+	}
+
+	vector<float> triangle_scores(num_triangles);
+	for (size_t triangle=0; triangle<num_triangles; triangle++)
+	{
+		const uint32_t *corners = &indices[triangle * 3];
+		triangle_scores[triangle] = vertex_scores[corners[0]] + vertex_scores[corners[1]] + vertex_scores[corners[2]];
+	}
+
+	vector<bool> emitted(num_triangles, false);
+	vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	// The cache, with room for the three vertices pushed in ahead of the ones falling out
+	uint32_t cache[CacheSize + 3];
+	int cache_used = 0;
+	size_t next_unemitted = 0;
+
+	int64_t best = 0;
+	for (size_t triangle=1; triangle<num_triangles; triangle++)
+	{
+		if (triangle_scores[triangle] > triangle_scores[best])
+		{
+			best = static_cast<int64_t>(triangle);
+		}
+	}
+
+	while (best >= 0)
+	{
+		const uint32_t *corners = &indices[best * 3];
+		output.insert(output.end(), corners, corners + 3);
+		emitted[best] = true;
+
+		// Move the triangle's vertices to the front of the cache and take it off their lists
+		uint32_t new_cache[CacheSize + 3];
+		int new_used = 0;
+		for (int i=0; i<3; i++)
+		{
+			uint32_t vertex = corners[i];
+			new_cache[new_used++] = vertex;
+
+			uint32_t *list = &triangles[offsets[vertex]];
+			uint32_t *last = list + remaining[vertex] - 1;
+			*find(list, last + 1, static_cast<uint32_t>(best)) = *last;
+			remaining[vertex]--;
+		}
+		for (int i=0; i<cache_used; i++)
+		{
+			uint32_t vertex = cache[i];
+			if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+			{
+				new_cache[new_used++] = vertex;
+			}
+		}
+
+		// Rescore what is in the cache, and what just fell out of it
+		for (int i=0; i<new_used; i++)
+		{
+			uint32_t vertex = new_cache[i];
+			cache_position[vertex] = i < CacheSize ? i : -1;
+			vertex_scores[vertex] = vertexScore(cache_position[vertex], remaining[vertex]);
+		}
+
+		// The next triangle is the best one touching the cache
+		best = -1;
+		float best_score = -1.0f;
+		for (int i=0; i<new_used; i++)
+		{
+			uint32_t vertex = new_cache[i];
+			for (uint32_t j=0; j<remaining[vertex]; j++)
+			{
+				uint32_t triangle = triangles[offsets[vertex] + j];
+				const uint32_t *other = &indices[triangle * 3];
+				float score = vertex_scores[other[0]] + vertex_scores[other[1]] + vertex_scores[other[2]];
+				triangle_scores[triangle] = score;
+				if (score > best_score)
+				{
+					best_score = score;
+					best = triangle;
+				}
+			}
+		}
+
+		cache_used = min(new_used, CacheSize);
+		memcpy(cache, new_cache, cache_used * sizeof(uint32_t));
+
+		// Nothing in the cache has triangles left, so carry on from the next one in the old order
+		if (best < 0)
+		{
+			while (next_unemitted < num_triangles && emitted[next_unemitted])
+			{
+				next_unemitted++;
+			}
+			if (next_unemitted < num_triangles)
+			{
+				best = static_cast<int64_t>(next_unemitted);
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(vector<float> &vertices, size_t stride, vector<uint32_t> &indices)
+{
+	size_t num_vertices = vertices.size() / stride;
+	vector<uint32_t> remap(num_vertices, UINT32_MAX);
+	vector<float> reordered(vertices.size());
+	uint32_t next = 0;
+
+	for (uint32_t &index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			memcpy(&reordered[next * stride], &vertices[index * stride], stride * sizeof(float));
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+
+	// Vertices no triangle uses are dropped
+	reordered.resize(next * stride);
+	vertices.swap(reordered);
+}
+
+float MeshOptimizer::averageCacheMissRatio(const vector<uint32_t> &indices, size_t num_vertices, size_t cache_size)
+{
+	if (indices.empty())
+	{
+		return 0.0f;
+	}
+
+	// When each vertex entered the cache, in misses
+	vector<size_t> entered(num_vertices, 0);
+	size_t misses = 0;
+	for (uint32_t index : indices)
+	{
+		if (entered[index] == 0 || misses + 1 - entered[index] > cache_size)
+		{
+			misses++;
+			entered[index] = misses;
+		}
+	}
+
+	return misses / static_cast<float>(indices.size() / 3);
+}
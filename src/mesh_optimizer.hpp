@@ -0,0 +1,33 @@
+#ifndef __MESH_OPTIMIZER_HPP__
+#define __MESH_OPTIMIZER_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * Reordering of indexed triangle lists so the GPU shades fewer vertices and fetches them in order.
+ * Neither changes what is drawn.
+ */
+class MeshOptimizer
+{
+public:
+	/// Reorder triangles so that consecutive ones share vertices, using Tom Forsyth's linear speed
+	/// vertex cache optimisation.
+	static void optimizeVertexCache(vector<uint32_t> &indices, size_t num_vertices);
+
+	/// Renumber vertices in the order the triangles first use them, moving their data to match.
+	static void optimizeVertexFetch(vector<float> &vertices, size_t stride, vector<uint32_t> &indices);
+
+	/// Vertices shaded per triangle through a FIFO post transform cache, between 0.5 and 3.
+	static float averageCacheMissRatio(const vector<uint32_t> &indices, size_t num_vertices, size_t cache_size = 16);
+
+private:
+	static constexpr int CacheSize = 32;
+
+	static float vertexScore(int cache_position, uint32_t remaining_triangles);
+};
+
+#endif // __MESH_OPTIMIZER_HPP__
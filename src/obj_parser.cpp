@@ -0,0 +1,602 @@
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <thread>
+#include <cstring>
+#include <cmath>
+#include "obj_parser.hpp"
+#include "mapped_file.hpp"
+
+// Face corner indices as read. Absolute indices are stored from zero. Relative (negative) ones
+// depend on how many elements come before the range, which isn't known until every range has
+// been read, so they are kept relative to the start of the range and offset by RelativeIndex.
+static constexpr int64_t NoIndex = INT64_MIN;
+static constexpr int64_t RelativeIndex = -(int64_t(1) << 40);
+
+// Everything read from one range of lines
+struct ObjParser::Range
+{
+	const char *begin = nullptr;
+	const char *end = nullptr;
+
+	vector<float> positions;
+	vector<float> tex_coords;
+	vector<float> normals;
+	vector<int64_t> corners; // Position, texture and normal index of each face corner
+	vector<uint32_t> face_sizes;
+	size_t num_triangles = 0;
+
+	// Elements and output from the ranges before this one
+	size_t position_base = 0;
+	size_t tex_coord_base = 0;
+	size_t normal_base = 0;
+	size_t corner_base = 0;
+	size_t index_base = 0;
+
+	// Elements of the whole file, joined once every range has been read
+	const Elements *elements = nullptr;
+};
+
+struct ObjParser::Elements
+{
+	vector<float> positions;
+	vector<float> tex_coords;
+	vector<float> normals;
+};
+
+// Key of a corner element that is missing or out of range
+static constexpr uint32_t NoElement = UINT32_MAX;
+
+static bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *skipBlanks(const char *p, const char *end)
+{
+	while (p < end && isBlank(*p))
+	{
+		p++;
+	}
+	return p;
+}
+
+// Powers of ten that a double holds exactly, so scaling by them only rounds once
+static const double exact_powers[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Decimal number with optional sign, fraction and exponent. Returns nullptr if there are no digits.
+// Up to 19 significant digits are kept, far more than a float can hold.
+static const char *parseFloat(const char *p, const char *end, float &value)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+	{
+		any = true;
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+			digits += mantissa != 0;
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+		{
+			any = true;
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+				digits += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+
+	if (!any)
+	{
+		return nullptr;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char *start = p + 1 < end && *(p + 1) == '+' ? p + 2 : p + 1;
+		int power = 0;
+		auto result = from_chars(start, end, power);
+		if (result.ec == errc())
+		{
+			exponent += power;
+			p = result.ptr;
+		}
+	}
+
+	double number = static_cast<double>(mantissa);
+	if (exponent >= 0)
+	{
+		number = exponent <= 22 ? number * exact_powers[exponent] : number * pow(10.0, exponent);
+	}
+	else
+	{
+		number = exponent >= -22 ? number / exact_powers[-exponent] : number * pow(10.0, exponent);
+	}
+
+	value = static_cast<float>(negative ? -number : number);
+	return p;
+}
+
+// Read up to count numbers, leaving the rest at zero
+static void readFloats(const char *p, const char *end, vector<float> &out, int count)
+{
+	for (int i=0; i<count; i++)
+	{
+		float value = 0.0f;
+		p = skipBlanks(p, end);
+		const char *next = p < end ? parseFloat(p, end, value) : nullptr;
+		if (next)
+		{
+			p = next;
+		}
+		out.push_back(next ? value : 0.0f);
+	}
+}
+
+// Store an index as read, see NoIndex and RelativeIndex
+static int64_t storeIndex(int32_t index, size_t count)
+{
+	if (index > 0)
+	{
+		return index - 1;
+	}
+	if (index < 0)
+	{
+		return static_cast<int64_t>(count) + index + RelativeIndex;
+	}
+	return NoIndex;
+}
+
+// Index into the whole file's elements, or -1 if it doesn't refer to one
+static int64_t resolveIndex(int64_t index, size_t base, size_t count)
+{
+	if (index == NoIndex)
+	{
+		return -1;
+	}
+
+	int64_t resolved = index >= 0 ? index : index - RelativeIndex + static_cast<int64_t>(base);
+	return resolved < static_cast<int64_t>(count) ? resolved : -1;
+}
+
+void ObjParser::parseFace(const char *p, const char *end, Range &range)
+{
+	size_t first = range.corners.size();
+
+	while (true)
+	{
+		p = skipBlanks(p, end);
+
+		int32_t position = 0;
+		auto result = from_chars(p, end, position);
+		if (result.ec != errc())
+		{
+			break;
+		}
+		p = result.ptr;
+
+		// Corners are v, v/vt, v//vn or v/vt/vn
+		int32_t tex_coord = 0;
+		int32_t normal = 0;
+		if (p < end && *p == '/')
+		{
+			p++;
+			result = from_chars(p, end, tex_coord);
+			p = result.ptr;
+
+			if (p < end && *p == '/')
+			{
+				p++;
+				result = from_chars(p, end, normal);
+				p = result.ptr;
+			}
+		}
+
+		range.corners.push_back(storeIndex(position, range.positions.size() / 3));
+		range.corners.push_back(storeIndex(tex_coord, range.tex_coords.size() / 2));
+		range.corners.push_back(storeIndex(normal, range.normals.size() / 3));
+
+		// Anything else stuck to the corner is ignored
+		while (p < end && !isBlank(*p))
+		{
+			p++;
+		}
+	}
+
+	size_t count = (range.corners.size() - first) / 3;
+	if (count < 3)
+	{
+		range.corners.resize(first);
+		return;
+	}
+
+	range.face_sizes.push_back(static_cast<uint32_t>(count));
+	range.num_triangles += count - 2;
+}
+
+void ObjParser::parseRange(Range &range)
+{
+	for (const char *p = range.begin; p < range.end; )
+	{
+		const char *line_end = static_cast<const char*>(memchr(p, '\n', range.end - p));
+		if (!line_end)
+		{
+			line_end = range.end;
+		}
+
+		p = skipBlanks(p, line_end);
+		if (line_end - p >= 2 && p[0] == 'v' && isBlank(p[1]))
+		{
+			readFloats(p + 2, line_end, range.positions, 3);
+		}
+		else if (line_end - p >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+		{
+			readFloats(p + 3, line_end, range.tex_coords, 2);
+		}
+		else if (line_end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+		{
+			readFloats(p + 3, line_end, range.normals, 3);
+		}
+		else if (line_end - p >= 2 && p[0] == 'f' && isBlank(p[1]))
+		{
+			parseFace(p + 2, line_end, range);
+		}
+
+		p = line_end + 1;
+	}
+}
+
+void ObjParser::triangulate(const float *points, uint32_t count, uint32_t base, vector<uint32_t> &scratch, uint32_t *out)
+{
+	if (count == 3)
+	{
+		out[0] = base;
+		out[1] = base + 1;
+		out[2] = base + 2;
+		return;
+	}
+
+	// Newell's method gives the polygon's normal even when it is concave or slightly bent
+	double normal[3] = { 0.0, 0.0, 0.0 };
+	for (uint32_t i=0; i<count; i++)
+	{
+		const float *a = points + i * 3;
+		const float *b = points + ((i + 1) % count) * 3;
+		normal[0] += (static_cast<double>(a[1]) - b[1]) * (static_cast<double>(a[2]) + b[2]);
+		normal[1] += (static_cast<double>(a[2]) - b[2]) * (static_cast<double>(a[0]) + b[0]);
+		normal[2] += (static_cast<double>(a[0]) - b[0]) * (static_cast<double>(a[1]) + b[1]);
+	}
+
+	// Work in the plane facing the normal the most, flipped so that the polygon winds anticlockwise
+	int drop = 0;
+	for (int axis=1; axis<3; axis++)
+	{
+		if (fabs(normal[axis]) > fabs(normal[drop]))
+		{
+			drop = axis;
+		}
+	}
+	int u_axis = (drop + 1) % 3;
+	int v_axis = (drop + 2) % 3;
+	double winding = normal[drop] >= 0.0 ? 1.0 : -1.0;
+
+	auto u = [&](uint32_t i) { return static_cast<double>(points[i * 3 + u_axis]); };
+	auto v = [&](uint32_t i) { return static_cast<double>(points[i * 3 + v_axis]); };
+	auto cross = [&](uint32_t a, uint32_t b, uint32_t c) {
+		return ((u(b) - u(a)) * (v(c) - v(a)) - (v(b) - v(a)) * (u(c) - u(a))) * winding;
+	};
+
+	scratch.resize(count);
+	for (uint32_t i=0; i<count; i++)
+	{
+		scratch[i] = i;
+	}
+
+	// Clip off corners that are convex and have no other corner inside them until a triangle is left
+	size_t written = 0;
+	while (scratch.size() > 3)
+	{
+		size_t remaining = scratch.size();
+		bool clipped = false;
+
+		for (size_t i=0; i<remaining && !clipped; i++)
+		{
+			uint32_t a = scratch[(i + remaining - 1) % remaining];
+			uint32_t b = scratch[i];
+			uint32_t c = scratch[(i + 1) % remaining];
+
+			if (cross(a, b, c) <= 0.0)
+			{
+				continue;
+			}
+
+			bool empty = true;
+			for (size_t j=0; j<remaining && empty; j++)
+			{
+				uint32_t p = scratch[j];
+				if (p != a && p != b && p != c)
+				{
+					// Corners on the edge count as inside, or the ear could cut across a reflex corner
+					empty = !(cross(a, b, p) >= 0.0 && cross(b, c, p) >= 0.0 && cross(c, a, p) >= 0.0);
+				}
+			}
+
+			if (empty)
+			{
+				out[written++] = base + a;
+				out[written++] = base + b;
+				out[written++] = base + c;
+				scratch.erase(scratch.begin() + i);
+				clipped = true;
+			}
+		}
+
+		// Degenerate or self intersecting, so just fan across what is left
+		if (!clipped)
+		{
+			for (size_t i=1; i+1<scratch.size(); i++)
+			{
+				out[written++] = base + scratch[0];
+				out[written++] = base + scratch[i];
+				out[written++] = base + scratch[i + 1];
+			}
+			return;
+		}
+	}
+
+	out[written++] = base + scratch[0];
+	out[written++] = base + scratch[1];
+	out[written++] = base + scratch[2];
+}
+
+void ObjParser::buildRange(const Range &range, uint32_t *keys, uint32_t *indices, size_t &bad_indices)
+{
+	const Elements &elements = *range.elements;
+	size_t num_positions = elements.positions.size() / 3;
+	size_t num_tex_coords = elements.tex_coords.size() / 2;
+	size_t num_normals = elements.normals.size() / 3;
+
+	size_t corner = range.corner_base;
+	const int64_t *read = range.corners.data();
+	uint32_t *out = indices + range.index_base;
+	vector<float> points;
+	vector<uint32_t> scratch;
+
+	for (uint32_t count : range.face_sizes)
+	{
+		// Resolve each corner to the elements it uses, and gather positions for triangulating
+		points.assign(count * 3, 0.0f);
+		for (uint32_t i=0; i<count; i++, read+=3)
+		{
+			uint32_t *key = keys + (corner + i) * 3;
+
+			int64_t position = resolveIndex(read[0], range.position_base, num_positions);
+			key[0] = position >= 0 ? static_cast<uint32_t>(position) : NoElement;
+			if (position >= 0)
+			{
+				memcpy(&points[i * 3], &elements.positions[position * 3], 3 * sizeof(float));
+			}
+			else
+			{
+				bad_indices++;
+			}
+
+			// Corners without a texture coordinate or normal get zero
+			int64_t tex_coord = resolveIndex(read[1], range.tex_coord_base, num_tex_coords);
+			key[1] = tex_coord >= 0 ? static_cast<uint32_t>(tex_coord) : NoElement;
+			bad_indices += tex_coord < 0 && read[1] != NoIndex;
+
+			int64_t normal = resolveIndex(read[2], range.normal_base, num_normals);
+			key[2] = normal >= 0 ? static_cast<uint32_t>(normal) : NoElement;
+			bad_indices += normal < 0 && read[2] != NoIndex;
+		}
+
+		triangulate(points.data(), count, static_cast<uint32_t>(corner), scratch, out);
+		corner += count;
+		out += (count - 2) * 3;
+	}
+}
+
+static uint32_t hashKey(const uint32_t *key)
+{
+	uint32_t hash = key[0] * 0x9e3779b1u ^ key[1] * 0x85ebca77u ^ key[2] * 0xc2b2ae3du;
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6du;
+	return hash ^ hash >> 12;
+}
+
+void ObjParser::shareVertices(const Elements &elements, const vector<uint32_t> &keys, Mesh &mesh)
+{
+	size_t num_corners = keys.size() / 3;
+
+	// Open addressing table of vertices, at most half full
+	size_t capacity = 16;
+	while (capacity < num_corners * 2)
+	{
+		capacity *= 2;
+	}
+	vector<uint32_t> table(capacity, NoElement);
+	vector<uint32_t> vertex_corners; // First corner of each vertex, for comparing keys
+	vector<uint32_t> remap(num_corners);
+	vertex_corners.reserve(num_corners);
+
+	for (size_t corner=0; corner<num_corners; corner++)
+	{
+		const uint32_t *key = &keys[corner * 3];
+		size_t slot = hashKey(key) & (capacity - 1);
+		while (table[slot] != NoElement && memcmp(&keys[vertex_corners[table[slot]] * 3], key, 3 * sizeof(uint32_t)) != 0)
+		{
+			slot = (slot + 1) & (capacity - 1);
+		}
+
+		if (table[slot] == NoElement)
+		{
+			table[slot] = static_cast<uint32_t>(vertex_corners.size());
+			vertex_corners.push_back(static_cast<uint32_t>(corner));
+		}
+		remap[corner] = table[slot];
+	}
+
+	mesh.vertices.assign(vertex_corners.size() * Stride, 0.0f);
+	for (size_t vertex=0; vertex<vertex_corners.size(); vertex++)
+	{
+		const uint32_t *key = &keys[vertex_corners[vertex] * 3];
+		float *out = &mesh.vertices[vertex * Stride];
+		if (key[0] != NoElement)
+		{
+			memcpy(out, &elements.positions[key[0] * 3], 3 * sizeof(float));
+		}
+		if (key[1] != NoElement)
+		{
+			memcpy(out + TexCoordOffset, &elements.tex_coords[key[1] * 2], 2 * sizeof(float));
+		}
+		if (key[2] != NoElement)
+		{
+			memcpy(out + NormalOffset, &elements.normals[key[2] * 3], 3 * sizeof(float));
+		}
+	}
+
+	for (uint32_t &index : mesh.indices)
+	{
+		index = remap[index];
+	}
+}
+
+// Run work(0) to work(count - 1) at once, the first on the calling thread
+template <typename Work>
+static void runParallel(size_t count, Work work)
+{
+	vector<thread> threads;
+	for (size_t i=1; i<count; i++)
+	{
+		threads.emplace_back(work, i);
+	}
+	work(0);
+
+	for (auto &t : threads)
+	{
+		t.join();
+	}
+}
+
+void ObjParser::parse(const char *text, size_t length, Mesh &mesh, Stats *stats, unsigned num_threads)
+{
+	auto start = chrono::steady_clock::now();
+
+	if (num_threads == 0)
+	{
+		num_threads = max(1u, thread::hardware_concurrency());
+	}
+
+	// Split into ranges of whole lines
+	size_t num_ranges = min(max<size_t>(length / MinRangeBytes, 1), static_cast<size_t>(num_threads));
+	vector<Range> ranges(num_ranges);
+	const char *end = text + length;
+	const char *begin = text;
+	for (size_t i=0; i<num_ranges; i++)
+	{
+		const char *split = i + 1 == num_ranges ? end : text + length / num_ranges * (i + 1);
+		if (split < begin)
+		{
+			split = begin;
+		}
+		const char *line_end = split < end ? static_cast<const char*>(memchr(split, '\n', end - split)) : nullptr;
+		split = line_end ? line_end + 1 : end;
+
+		ranges[i].begin = begin;
+		ranges[i].end = split;
+		begin = split;
+	}
+
+	runParallel(num_ranges, [&](size_t i) { parseRange(ranges[i]); });
+
+	// Everything before each range is now known
+	size_t num_corners = 0;
+	size_t num_triangles = 0;
+	size_t num_faces = 0;
+	Elements elements;
+	for (Range &range : ranges)
+	{
+		range.position_base = elements.positions.size() / 3;
+		range.tex_coord_base = elements.tex_coords.size() / 2;
+		range.normal_base = elements.normals.size() / 3;
+		range.corner_base = num_corners;
+		range.index_base = num_triangles * 3;
+		range.elements = &elements;
+
+		elements.positions.insert(elements.positions.end(), range.positions.begin(), range.positions.end());
+		elements.tex_coords.insert(elements.tex_coords.end(), range.tex_coords.begin(), range.tex_coords.end());
+		elements.normals.insert(elements.normals.end(), range.normals.begin(), range.normals.end());
+		num_corners += range.corners.size() / 3;
+		num_triangles += range.num_triangles;
+		num_faces += range.face_sizes.size();
+	}
+
+	// Triangles index corners until they are merged into vertices
+	vector<uint32_t> keys(num_corners * 3);
+	mesh.indices.resize(num_triangles * 3);
+	vector<size_t> bad_indices(num_ranges, 0);
+	runParallel(num_ranges, [&](size_t i) { buildRange(ranges[i], keys.data(), mesh.indices.data(), bad_indices[i]); });
+
+	shareVertices(elements, keys, mesh);
+
+	if (stats)
+	{
+		stats->bytes = length;
+		stats->ranges = num_ranges;
+		stats->faces = num_faces;
+		stats->corners = num_corners;
+		stats->vertices = mesh.numVertices();
+		stats->bad_indices = 0;
+		for (size_t bad : bad_indices)
+		{
+			stats->bad_indices += bad;
+		}
+		stats->milliseconds = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+	}
+}
+
+bool ObjParser::load(const string &filename, Mesh &mesh, Stats *stats, unsigned num_threads)
+{
+	auto start = chrono::steady_clock::now();
+
+	MappedFile file(filename);
+	if (!file.isValid())
+	{
+		return false;
+	}
+
+	parse(file.data(), file.size(), mesh, stats, num_threads);
+
+	// Count opening and mapping the file too
+	if (stats)
+	{
+		stats->milliseconds = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+#ifndef __OBJ_PARSER_HPP__
+#define __OBJ_PARSER_HPP__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * Fast reader for Wavefront OBJ geometry. The file is memory mapped and split into ranges of whole
+ * lines that are parsed on separate threads, then the faces of every range are assembled in
+ * parallel once the number of elements before each range is known. Quads and larger polygons are
+ * triangulated by ear clipping so concave faces come out right, and negative (relative) indices
+ * are supported. Only v, vt, vn and f lines are read, everything else is skipped. Face corners are
+ * then merged into shared vertices with a hash table, giving an interleaved vertex buffer and an
+ * index buffer.
+ */
+class ObjParser
+{
+public:
+	/// Floats per vertex: position, texture coordinate and normal.
+	static constexpr size_t Stride = 8;
+	static constexpr size_t TexCoordOffset = 3;
+	static constexpr size_t NormalOffset = 5;
+
+	/// Indexed geometry ready to upload. Face corners with the same position, texture coordinate
+	/// and normal share one vertex. Missing texture coordinates and normals are zero.
+	struct Mesh
+	{
+		vector<float> vertices;   // Stride floats for each vertex
+		vector<uint32_t> indices; // Three vertices for each triangle
+
+		size_t numVertices() const { return vertices.size() / Stride; }
+	};
+
+	struct Stats
+	{
+		size_t bytes = 0;        // Size of the file
+		size_t ranges = 0;       // Parts parsed in parallel
+		size_t faces = 0;        // Faces read, before triangulation
+		size_t corners = 0;      // Face corners, each a vertex before they are shared
+		size_t vertices = 0;     // Distinct vertices left after sharing
+		size_t bad_indices = 0;  // Corners referring to elements that don't exist, which are zeroed
+		float milliseconds = 0.0f;
+
+		float megabytesPerSecond() const { return milliseconds > 0.0f ? bytes / (1024.0f * 1024.0f) / (milliseconds / 1000.0f) : 0.0f; }
+	};
+
+	/// Read a file. Zero threads uses one per hardware thread. False if the file can't be read.
+	static bool load(const string &filename, Mesh &mesh, Stats *stats = nullptr, unsigned num_threads = 0);
+
+	/// Parse OBJ text that is already in memory.
+	static void parse(const char *text, size_t length, Mesh &mesh, Stats *stats = nullptr, unsigned num_threads = 0);
+
+private:
+	struct Range;
+	struct Elements;
+
+	// Ranges smaller than this aren't worth a thread of their own
+	static constexpr size_t MinRangeBytes = 1 << 20;
+
+	static void parseRange(Range &range);
+	static void parseFace(const char *p, const char *end, Range &range);
+	static void buildRange(const Range &range, uint32_t *keys, uint32_t *indices, size_t &bad_indices);
+	static void shareVertices(const Elements &elements, const vector<uint32_t> &keys, Mesh &mesh);
+	static void triangulate(const float *points, uint32_t count, uint32_t base, vector<uint32_t> &scratch, uint32_t *out);
+};
+
+#endif // __OBJ_PARSER_HPP__
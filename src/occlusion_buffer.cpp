@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include "occlusion_buffer.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Points closer than this to the camera plane are treated as behind it
+constexpr float NearW = 0.01f;
+
+OcclusionBuffer::OcclusionBuffer(int width, int height, unsigned num_threads) :
+	buffer_width((width + 3) & ~3), buffer_height(height)
+{
+	depth.assign(buffer_width * buffer_height, FLT_MAX);
+
+	if (num_threads == 0)
+	{
+		num_threads = min(max(thread::hardware_concurrency(), 1u), 4u);
+	}
+	num_bands = min(num_threads, static_cast<unsigned>(buffer_height));
+
+	for (unsigned band=1; band<num_bands; band++)
+	{
+		workers.emplace_back(&OcclusionBuffer::run, this, band);
+	}
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	work_ready.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void OcclusionBuffer::begin(const glm::mat4 &matrix)
+{
+	view_projection = matrix;
+	quads.clear();
+	counters = Stats();
+}
+
+bool OcclusionBuffer::project(const glm::vec3 &point, float &x, float &y, float &w) const
+{
+	glm::vec4 clip = view_projection * glm::vec4(point, 1.0f);
+	if (clip.w < NearW)
+	{
+		return false;
+	}
+
+	x = (clip.x / clip.w * 0.5f + 0.5f) * buffer_width;
+	y = (clip.y / clip.w * 0.5f + 0.5f) * buffer_height;
+	w = clip.w;
+	return true;
+}
+
+void OcclusionBuffer::addOccluders(const vector<glm::vec3> &corners, const glm::mat4 &model)
+{
+	auto start = chrono::steady_clock::now();
+
+	// Corners go round the quad in this order rather than the order they are drawn in
+	constexpr int outline[4] = { 0, 1, 3, 2 };
+
+	for (size_t i=0; i+3<corners.size(); i+=4)
+	{
+		Quad quad;
+		quad.depth = 0.0f;
+		bool in_front = true;
+
+		for (int j=0; j<4 && in_front; j++)
+		{
+			float w;
+			in_front = project(glm::vec3(model * glm::vec4(corners[i + outline[j]], 1.0f)), quad.x[j], quad.y[j], w);
+			quad.depth = max(quad.depth, w);
+		}
+
+		// Clipping isn't worth it for an occluder, losing one only means drawing more
+		if (!in_front)
+		{
+			continue;
+		}
+
+		// Counter clockwise quads face the camera, the same as GL's default
+		float area = 0.0f;
+		float min_x = FLT_MAX;
+		float max_x = -FLT_MAX;
+		float min_y = FLT_MAX;
+		float max_y = -FLT_MAX;
+		for (int j=0; j<4; j++)
+		{
+			int k = (j + 1) % 4;
+			area += quad.x[j] * quad.y[k] - quad.x[k] * quad.y[j];
+			min_x = min(min_x, quad.x[j]);
+			max_x = max(max_x, quad.x[j]);
+			min_y = min(min_y, quad.y[j]);
+			max_y = max(max_y, quad.y[j]);
+		}
+
+		if (area <= 0.0f || max_x < 0.0f || min_x > buffer_width || max_y < 0.0f || min_y > buffer_height)
+		{
+			continue;
+		}
+
+		quad.min_row = max(static_cast<int>(floor(min_y)), 0);
+		quad.max_row = min(static_cast<int>(ceil(max_y)), buffer_height - 1);
+		quads.push_back(quad);
+	}
+
+	chrono::duration<float, milli> elapsed = chrono::steady_clock::now() - start;
+	counters.raster_ms += elapsed.count();
+}
+
+void OcclusionBuffer::rasterize()
+{
+	auto start = chrono::steady_clock::now();
+
+	fill(depth.begin(), depth.end(), FLT_MAX);
+
+	{
+		lock_guard<mutex> guard(lock);
+		bands_remaining = num_bands - 1;
+		frame++;
+	}
+	work_ready.notify_all();
+
+	rasterizeBand(0);
+
+	{
+		unique_lock<mutex> guard(lock);
+		work_done.wait(guard, [this] { return bands_remaining == 0; });
+	}
+
+	counters.occluders = quads.size();
+
+	chrono::duration<float, milli> elapsed = chrono::steady_clock::now() - start;
+	counters.raster_ms += elapsed.count();
+}
+
+void OcclusionBuffer::run(unsigned band)
+{
+	unsigned last_frame = 0;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> guard(lock);
+			work_ready.wait(guard, [this, last_frame] { return stopping || frame != last_frame; });
+
+			if (stopping)
+			{
+				return;
+			}
+			last_frame = frame;
+		}
+
+		rasterizeBand(band);
+
+		{
+			lock_guard<mutex> guard(lock);
+			bands_remaining--;
+		}
+		work_done.notify_one();
+	}
+}
+
+void OcclusionBuffer::rasterizeBand(unsigned band)
+{
+	int first_row = band * buffer_height / num_bands;
+	int last_row = (band + 1) * buffer_height / num_bands - 1;
+
+	for (const auto &quad : quads)
+	{
+		int start_row = max(quad.min_row, first_row);
+		int end_row = min(quad.max_row, last_row);
+		if (start_row > end_row)
+		{
+			continue;
+		}
+
+		// Edge functions a * x + b * y + c, positive inside. Pulling each edge in by half a pixel
+		// along both axes means only pixels entirely inside the quad pass at their centre.
+		float a[4];
+		float b[4];
+		float c[4];
+		for (int i=0; i<4; i++)
+		{
+			int j = (i + 1) % 4;
+			a[i] = quad.y[i] - quad.y[j];
+			b[i] = quad.x[j] - quad.x[i];
+			c[i] = -(a[i] * quad.x[i] + b[i] * quad.y[i]) - 0.5f * (fabs(a[i]) + fabs(b[i]));
+		}
+
+		for (int row=start_row; row<=end_row; row++)
+		{
+			float centre_y = row + 0.5f;
+			float left = 0.0f;
+			float right = static_cast<float>(buffer_width);
+
+			for (int i=0; i<4; i++)
+			{
+				float offset = b[i] * centre_y + c[i];
+				if (a[i] > 0.0f)
+				{
+					left = max(left, -offset / a[i]);
+				}
+				else if (a[i] < 0.0f)
+				{
+					right = min(right, -offset / a[i]);
+				}
+				else if (offset < 0.0f)
+				{
+					right = -1.0f;
+				}
+			}
+
+			// Pixels whose centres lie within the span
+			int start = max(static_cast<int>(ceil(left - 0.5f)), 0);
+			int end = min(static_cast<int>(floor(right - 0.5f)), buffer_width - 1);
+
+			float *pixels = &depth[row * buffer_width];
+			int x = start;
+#if defined(__SSE2__)
+			__m128 value = _mm_set1_ps(quad.depth);
+			for (; x + 3 <= end; x += 4)
+			{
+				_mm_storeu_ps(pixels + x, _mm_min_ps(_mm_loadu_ps(pixels + x), value));
+			}
+#endif
+			for (; x <= end; x++)
+			{
+				pixels[x] = min(pixels[x], quad.depth);
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::isVisible(const AABB &box)
+{
+	auto start = chrono::steady_clock::now();
+	counters.tested++;
+
+	bool visible = false;
+	float min_x = FLT_MAX;
+	float max_x = -FLT_MAX;
+	float min_y = FLT_MAX;
+	float max_y = -FLT_MAX;
+	float nearest = FLT_MAX;
+
+	for (int i=0; i<8 && !visible; i++)
+	{
+		glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+
+		float x;
+		float y;
+		float w;
+		if (!project(corner, x, y, w))
+		{
+			// Reaches past the camera so assume it can be seen
+			visible = true;
+			break;
+		}
+
+		min_x = min(min_x, x);
+		max_x = max(max_x, x);
+		min_y = min(min_y, y);
+		max_y = max(max_y, y);
+		nearest = min(nearest, w);
+	}
+
+	if (!visible)
+	{
+		// Every pixel the box touches must be covered by something nearer
+		int start_x = max(static_cast<int>(floor(min_x)), 0);
+		int end_x = min(static_cast<int>(ceil(max_x)) - 1, buffer_width - 1);
+		int start_y = max(static_cast<int>(floor(min_y)), 0);
+		int end_y = min(static_cast<int>(ceil(max_y)) - 1, buffer_height - 1);
+
+		// Off screen altogether, which is for the frustum test to decide
+		visible = start_x > end_x || start_y > end_y;
+
+		for (int row=start_y; row<=end_y && !visible; row++)
+		{
+			const float *pixels = &depth[row * buffer_width];
+			int x = start_x;
+#if defined(__SSE2__)
+			__m128 value = _mm_set1_ps(nearest);
+			for (; x + 3 <= end_x; x += 4)
+			{
+				if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(pixels + x), value)) != 0)
+				{
+					visible = true;
+					break;
+				}
+			}
+#endif
+			for (; x <= end_x && !visible; x++)
+			{
+				visible = pixels[x] >= nearest;
+			}
+		}
+	}
+
+	if (!visible)
+	{
+		counters.occluded++;
+	}
+
+	chrono::duration<float, milli> elapsed = chrono::steady_clock::now() - start;
+	counters.test_ms += elapsed.count();
+	return visible;
+}
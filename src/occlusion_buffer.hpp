@@ -0,0 +1,96 @@
+#ifndef __OCCLUSION_BUFFER_HPP__
+#define __OCCLUSION_BUFFER_HPP__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+using namespace std;
+
+/**
+ * Low resolution depth buffer drawn on the CPU from the faces of nearby blocks, used to skip
+ * blocks hidden behind them. Occluders only cover pixels they fully contain and the boxes being
+ * tested cover every pixel they touch, so it errs on the side of drawing.
+ *
+ * Each frame call begin(), add the occluders, rasterize() and then test with isVisible(). The
+ * screen is split into bands of rows that are drawn in parallel. No GL calls are made.
+ */
+class OcclusionBuffer
+{
+public:
+	struct Stats
+	{
+		size_t occluders = 0;  // Quads drawn into the buffer
+		size_t tested = 0;     // Boxes tested against the buffer
+		size_t occluded = 0;   // Boxes found to be hidden
+		float raster_ms = 0.0f; // Time spent setting up and drawing occluders
+		float test_ms = 0.0f;   // Time spent testing boxes
+	};
+
+	/// Width is rounded up to a multiple of four. Zero threads picks up to four from the hardware.
+	OcclusionBuffer(int width = 256, int height = 128, unsigned num_threads = 0);
+	~OcclusionBuffer();
+
+	/// Clear the buffer and set the projection * view matrix for the frame. Resets the stats.
+	void begin(const glm::mat4 &view_projection);
+
+	/// Add quads (four corners each, in the order drawn as triangles 0 1 2 and 2 1 3) in model space.
+	/// Quads pointing away from the camera or crossing the near plane are skipped.
+	void addOccluders(const vector<glm::vec3> &corners, const glm::mat4 &model);
+
+	/// Draw the occluders added since begin().
+	void rasterize();
+
+	/// False if a world space box is hidden behind the occluders.
+	bool isVisible(const AABB &box);
+
+	const Stats &stats() const { return counters; }
+
+	int width() const { return buffer_width; }
+	int height() const { return buffer_height; }
+	float depthAt(int x, int y) const { return depth[y * buffer_width + x]; }
+
+private:
+	// Screen space quad with a single depth, the furthest of its corners. Quads are drawn whole
+	// rather than as two triangles so that no crack opens up along the diagonal.
+	struct Quad
+	{
+		float x[4];
+		float y[4];
+		float depth;
+		int min_row;
+		int max_row;
+	};
+
+	bool project(const glm::vec3 &point, float &x, float &y, float &w) const;
+	void rasterizeBand(unsigned band);
+	void run(unsigned band);
+
+	int buffer_width;
+	int buffer_height;
+	vector<float> depth; // Distance along the view direction, large where nothing has been drawn
+
+	glm::mat4 view_projection = glm::mat4(1);
+	vector<Quad> quads;
+	Stats counters;
+
+	// Band zero is drawn by the caller and the others by the workers
+	unsigned num_bands;
+	vector<thread> workers;
+	mutex lock;
+	condition_variable work_ready;
+	condition_variable work_done;
+	unsigned frame = 0;
+	unsigned bands_remaining = 0;
+	bool stopping = false;
+};
+
+#endif // __OCCLUSION_BUFFER_HPP__
@@ -12,13 +12,29 @@ void Options::initialize(int argc, char *argv[])
 		{"verbose", no_argument, 0, 'v'},
 		{"width", required_argument, 0, 'w'},
 		{"height", required_argument, 0, 'h'},
+		{"mesh", required_argument, 0, 'm'},
+		{"vertices", required_argument, 0, 'x'},
+		{"radius", required_argument, 0, 'r'},
+		{"lod", required_argument, 0, 'l'},
+		{"prefetch", required_argument, 0, 'p'},
+		{"occluders", required_argument, 0, 'o'},
+		{"obj", required_argument, 0, 'j'},
+		{"instances", required_argument, 0, 'n'},
+		{"world", required_argument, 0, 'd'},
+		{"pack", required_argument, 0, 'k'},
+		{"profile", required_argument, 0, 'P'},
+		{"benchmark", required_argument, 0, 'b'},
+		{"frames", required_argument, 0, 'F'},
+		{"report", required_argument, 0, 'O'},
+		{"record", required_argument, 0, 'R'},
+		{"edits", required_argument, 0, 'e'},
 		{0, 0, 0, 0}
 	};
 
 	while (true)
 	{
 		int option_index = 0;
-		int c = getopt_long(argc, argv, "vf:w:h:", long_options, &option_index);
+		int c = getopt_long(argc, argv, "vf:w:h:m:x:r:l:p:o:j:n:d:k:P:b:F:O:R:e:", long_options, &option_index);
 
 		if (c == -1)
 		{
@@ -39,6 +55,54 @@ void Options::initialize(int argc, char *argv[])
 		case 'h':
 			m_height = atoi(optarg);
 			break;
+		case 'm':
+			m_mesh = optarg;
+			break;
+		case 'x':
+			m_vertices = optarg;
+			break;
+		case 'r':
+			m_radius = atoi(optarg);
+			break;
+		case 'l':
+			m_lod = static_cast<float>(atof(optarg));
+			break;
+		case 'p':
+			m_prefetch = static_cast<float>(atof(optarg));
+			break;
+		case 'o':
+			m_occluders = atoi(optarg);
+			break;
+		case 'j':
+			m_obj = optarg;
+			break;
+		case 'n':
+			m_instances = atoi(optarg);
+			break;
+		case 'd':
+			m_world = optarg;
+			break;
+		case 'k':
+			m_pack = optarg;
+			break;
+		case 'P':
+			m_profile = optarg;
+			break;
+		case 'b':
+			m_benchmark = optarg;
+			break;
+		case 'F':
+			m_frames = atoi(optarg);
+			break;
+		case 'O':
+			m_report = optarg;
+			break;
+		case 'R':
+			m_record = optarg;
+			break;
+		case 'e':
+			m_edits = atoi(optarg);
+			break;
 		}
 	}
 }
@@ -49,4 +113,20 @@ void Options::display_help(const char *app_name)
 	cout << "  --verbose - enable verbose output.\n";
 	cout << "  --width <width> - width of display in pixels.\n";
 	cout << "  --height <height> - height of display in pixels.\n";
+	cout << "  --mesh <naive|culled|greedy> - how block faces are generated (default greedy).\n";
+	cout << "  --vertices <packed|float> - vertex format of block meshes (default packed).\n";
+	cout << "  --radius <blocks> - distance around the camera that blocks are loaded (default 40).\n";
+	cout << "  --lod <blocks> - distance where blocks drop to half detail, doubling for each further level, 0 to disable (default 4).\n";
+	cout << "  --prefetch <seconds> - how far ahead of the camera blocks are read, in seconds of travel at its current speed (default 2).\n";
+	cout << "  --occluders <blocks> - nearest blocks drawn into the occlusion buffer, 0 to disable (default 16).\n";
+	cout << "  --obj <file> - wavefront object to scatter copies of across the map.\n";
+	cout << "  --instances <count> - number of copies of the object (default 1000).\n";
+	cout << "  --world <directory> - load blocks from region files made by orbis_convert instead of the built in map.\n";
+	cout << "  --pack <file> - load shaders, textures and objects from a pack made by orbis_pack, falling back to loose files.\n";
+	cout << "  --profile <file> - start with the profiler and its overlay on (F3 switches them), writing frame time percentiles to this CSV file on exit.\n";
+	cout << "  --benchmark <file> - fly the camera path in the file at a fixed 60 steps a second without a window, then report timings and exit.\n";
+	cout << "  --frames <count> - frames to render in a benchmark (default enough to reach the end of the path).\n";
+	cout << "  --report <file> - where to write the benchmark report as JSON (default standard output).\n";
+	cout << "  --record <file> - save the route flown in this session as a camera path for --benchmark.\n";
+	cout << "  --edits <count> - voxels to change at random around the camera every frame, to test remeshing (default 0).\n";
 }
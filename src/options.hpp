@@ -1,6 +1,8 @@
 #ifndef __OPTIONS_HPP__
 #define __OPTIONS_HPP__
 
+#include <string>
+
 class Options
 {
 public:
@@ -10,6 +12,22 @@ public:
 	bool verbose() const { return m_verbose; }
 	int width() const { return m_width; }
 	int height() const { return m_height; }
+	const std::string &mesh() const { return m_mesh; }
+	const std::string &vertices() const { return m_vertices; }
+	int radius() const { return m_radius; }
+	float lod() const { return m_lod; }
+	float prefetch() const { return m_prefetch; }
+	int occluders() const { return m_occluders; }
+	const std::string &obj() const { return m_obj; }
+	const std::string &world() const { return m_world; }
+	const std::string &pack() const { return m_pack; }
+	int instances() const { return m_instances; }
+	const std::string &profile() const { return m_profile; }
+	const std::string &benchmark() const { return m_benchmark; }
+	int frames() const { return m_frames; }
+	const std::string &report() const { return m_report; }
+	const std::string &record() const { return m_record; }
+	int edits() const { return m_edits; }
 
 private:
 	void initialize(int argc, char *argv[]);
@@ -18,6 +36,22 @@ private:
 	bool m_verbose = false;
 	int m_width = 1024;
 	int m_height = 768;
+	std::string m_mesh = "greedy";
+	std::string m_vertices = "packed";
+	int m_radius = 40;
+	float m_lod = 4.0f;
+	float m_prefetch = 2.0f;
+	int m_occluders = 16;
+	std::string m_obj;
+	std::string m_world;
+	std::string m_pack;
+	int m_instances = 1000;
+	std::string m_profile;
+	std::string m_benchmark;
+	int m_frames = 0;
+	std::string m_report;
+	std::string m_record;
+	int m_edits = 0;
 };
 
 #endif // __OPTIONS_HPP__
@@ -0,0 +1,159 @@
+// Packs shaders, PNG textures and OBJ models into one file that Orbis can load with --pack
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "asset_pack.hpp"
+#include "image.hpp"
+#include "obj_parser.hpp"
+#include "mesh_optimizer.hpp"
+
+using namespace std;
+
+static bool endsWith(const string &text, const string &suffix)
+{
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Turn one file into the data and entry for it, by its extension
+static bool prepare(const string &path, AssetPack::Entry &entry, vector<uint8_t> &data)
+{
+	if (path.size() >= sizeof(entry.name))
+	{
+		cerr << "Path is too long to pack: " << path << endl;
+		return false;
+	}
+	memset(&entry, 0, sizeof(entry));
+	memcpy(entry.name, path.c_str(), path.size());
+
+	if (endsWith(path, ".glsl"))
+	{
+		ifstream file(path, ios::in | ios::binary);
+		if (!file.is_open())
+		{
+			cerr << "Unable to open " << path << endl;
+			return false;
+		}
+
+		stringstream source;
+		source << file.rdbuf();
+		string text = source.str();
+		data.assign(text.begin(), text.end());
+		data.push_back(0);
+		entry.type = AssetPack::TypeShader;
+		return true;
+	}
+
+	if (endsWith(path, ".png"))
+	{
+		Image image;
+		if (!image.loadPng(path.c_str()))
+		{
+			return false;
+		}
+
+		// Every level down to one pixel, so GL needn't generate them at load time
+		int levels = Image::numLevels(image.width(), image.height());
+		entry.type = AssetPack::TypeTexture;
+		entry.params[0] = image.width();
+		entry.params[1] = image.height();
+		entry.params[2] = levels;
+		data.assign(image.data(), image.data() + image.size());
+		for (int level=1; level<levels; level++)
+		{
+			image = image.halved();
+			data.insert(data.end(), image.data(), image.data() + image.size());
+		}
+		return true;
+	}
+
+	if (endsWith(path, ".obj"))
+	{
+		ObjParser::Mesh mesh;
+		if (!ObjParser::load(path, mesh))
+		{
+			return false;
+		}
+
+		MeshOptimizer::optimizeVertexCache(mesh.indices, mesh.numVertices());
+		MeshOptimizer::optimizeVertexFetch(mesh.vertices, ObjParser::Stride, mesh.indices);
+
+		entry.type = AssetPack::TypeMesh;
+		entry.params[0] = static_cast<uint32_t>(mesh.numVertices());
+		entry.params[1] = static_cast<uint32_t>(mesh.indices.size());
+		entry.params[2] = ObjParser::Stride;
+		const uint8_t *vertices = reinterpret_cast<const uint8_t*>(mesh.vertices.data());
+		const uint8_t *indices = reinterpret_cast<const uint8_t*>(mesh.indices.data());
+		data.assign(vertices, vertices + mesh.vertices.size() * sizeof(float));
+		data.insert(data.end(), indices, indices + mesh.indices.size() * sizeof(uint32_t));
+		return true;
+	}
+
+	cerr << "Don't know how to pack " << path << ", expected .glsl, .png or .obj\n";
+	return false;
+}
+
+static size_t align(size_t offset)
+{
+	return (offset + AssetPack::Alignment - 1) / AssetPack::Alignment * AssetPack::Alignment;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		cerr << "Usage: " << argv[0] << " <pack> <file>...\n";
+		cerr << "Files are found in the pack by the path given here, e.g. res/vertex_shader.glsl\n";
+		return 1;
+	}
+
+	vector<AssetPack::Entry> entries(argc - 2);
+	vector<vector<uint8_t>> data(argc - 2);
+	for (int i=2; i<argc; i++)
+	{
+		if (!prepare(argv[i], entries[i - 2], data[i - 2]))
+		{
+			return 1;
+		}
+	}
+
+	// Lay the assets out after the table, each on its own page
+	AssetPack::Header header = {};
+	memcpy(header.magic, AssetPack::Magic, sizeof(header.magic));
+	header.version = AssetPack::Version;
+	header.num_entries = static_cast<uint32_t>(entries.size());
+
+	size_t offset = align(sizeof(header) + entries.size() * sizeof(AssetPack::Entry));
+	for (size_t i=0; i<entries.size(); i++)
+	{
+		entries[i].offset = offset;
+		entries[i].size = data[i].size();
+		offset = align(offset + data[i].size());
+	}
+
+	ofstream pack(argv[1], ios::out | ios::binary | ios::trunc);
+	pack.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pack.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(AssetPack::Entry));
+	for (size_t i=0; i<entries.size(); i++)
+	{
+		pack.seekp(entries[i].offset);
+		pack.write(reinterpret_cast<const char*>(data[i].data()), data[i].size());
+	}
+
+	// Pad the last asset out to a whole page
+	pack.seekp(offset - 1);
+	pack.put(0);
+
+	if (!pack.good())
+	{
+		cerr << "Unable to write " << argv[1] << endl;
+		return 1;
+	}
+
+	cout << "Packed " << entries.size() << " assets into " << argv[1] << ", " << offset / 1024 << " KB\n";
+	return 0;
+}
@@ -0,0 +1,384 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include "profiler.hpp"
+
+Profiler::~Profiler()
+{
+	if (active == this)
+	{
+		active = nullptr;
+	}
+
+	for (auto &timer : timer_list)
+	{
+		for (GLuint query : timer.queries)
+		{
+			if (query != 0)
+			{
+				glDeleteQueries(1, &query);
+			}
+		}
+	}
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+	if (enabled == isEnabled())
+	{
+		return;
+	}
+
+	if (!enabled)
+	{
+		// Collect what is still in flight so that the timings aren't lost
+		readQueries(true);
+		active = nullptr;
+		return;
+	}
+
+	active = this;
+	last_refresh = chrono::steady_clock::now();
+	refresh_frames = 0;
+	refresh_frame_ms = 0.0;
+	refresh_counters = Counters();
+}
+
+void Profiler::beginFrame()
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	frame = static_cast<long>(frame_samples.size());
+	stack.clear();
+	gpu_timer = -1;
+	for (auto &timer : timer_list)
+	{
+		timer.frame_cpu_ms = 0.0f;
+	}
+
+	frame_start = chrono::steady_clock::now();
+}
+
+void Profiler::endFrame(const Counters &counters)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	auto now = chrono::steady_clock::now();
+	chrono::duration<float, milli> elapsed = now - frame_start;
+
+	frame_samples.push_back(elapsed.count());
+	gpu_frame_samples.push_back(0.0f);
+	counter_samples.push_back(counters);
+
+	for (auto &timer : timer_list)
+	{
+		timer.cpu_samples.push_back(timer.frame_cpu_ms);
+		timer.total_cpu_ms += timer.frame_cpu_ms;
+	}
+
+	// Results of earlier frames that the GPU has finished with
+	readQueries(false);
+
+	refresh_frames++;
+	refresh_frame_ms += elapsed.count();
+	refresh_counters.draws += counters.draws;
+	refresh_counters.triangles += counters.triangles;
+	refresh_counters.state_changes += counters.state_changes;
+	refresh_counters.uploads += counters.uploads;
+	refresh_counters.upload_bytes += counters.upload_bytes;
+
+	if (chrono::duration<float>(now - last_refresh).count() >= RefreshSeconds)
+	{
+		refresh();
+		last_refresh = now;
+	}
+}
+
+void Profiler::begin(const char *name, bool gpu)
+{
+	int parent = stack.empty() ? -1 : stack.back();
+
+	// There are only a handful of scopes, and literals for the same name are usually the same pointer
+	int index = -1;
+	for (size_t i=0; i<timer_list.size(); i++)
+	{
+		const Timer &timer = timer_list[i];
+		if (timer.parent == parent && (timer.name == name || strcmp(timer.name, name) == 0))
+		{
+			index = static_cast<int>(i);
+			break;
+		}
+	}
+
+	if (index < 0)
+	{
+		index = static_cast<int>(timer_list.size());
+		timer_list.emplace_back();
+		timer_list.back().name = name;
+		timer_list.back().parent = parent;
+		timer_list.back().depth = static_cast<int>(stack.size());
+	}
+
+	stack.push_back(index);
+	Timer &timer = timer_list[index];
+
+	int slot = static_cast<int>(frame % Timer::QueryFrames);
+	if (gpu && gpu_timer < 0 && timer.query_frames[slot] != frame)
+	{
+		// The query from QueryFrames ago is almost always finished by now
+		if (timer.query_frames[slot] >= 0)
+		{
+			readQuery(timer, slot, true);
+		}
+
+		if (timer.queries[slot] == 0)
+		{
+			glGenQueries(1, &timer.queries[slot]);
+		}
+
+		glBeginQuery(GL_TIME_ELAPSED, timer.queries[slot]);
+		timer.query_frames[slot] = frame;
+		timer.gpu = true;
+		gpu_timer = index;
+	}
+
+	timer.start = chrono::steady_clock::now();
+}
+
+void Profiler::end()
+{
+	if (stack.empty())
+	{
+		return;
+	}
+
+	int index = stack.back();
+	stack.pop_back();
+
+	Timer &timer = timer_list[index];
+	chrono::duration<float, milli> elapsed = chrono::steady_clock::now() - timer.start;
+	timer.frame_cpu_ms += elapsed.count();
+
+	if (gpu_timer == index)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		gpu_timer = -1;
+	}
+}
+
+void Profiler::readQuery(Timer &timer, int slot, bool wait)
+{
+	GLuint query = timer.queries[slot];
+	if (!wait)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			return;
+		}
+	}
+
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+	float ms = static_cast<float>(nanoseconds / 1.0e6);
+
+	size_t issued = static_cast<size_t>(timer.query_frames[slot]);
+	timer.query_frames[slot] = -1;
+	timer.gpu_samples.push_back(ms);
+	timer.total_gpu_ms += ms;
+	timer.gpu_results++;
+
+	// GPU scopes never overlap, so their sum is the GPU time of the frame
+	if (issued < gpu_frame_samples.size())
+	{
+		gpu_frame_samples[issued] += ms;
+	}
+}
+
+void Profiler::readQueries(bool wait)
+{
+	// Only called between scopes, so every query has been ended
+	for (auto &timer : timer_list)
+	{
+		for (int slot=0; slot<Timer::QueryFrames; slot++)
+		{
+			if (timer.query_frames[slot] >= 0)
+			{
+				readQuery(timer, slot, wait);
+			}
+		}
+	}
+}
+
+void Profiler::refresh()
+{
+	float frames = static_cast<float>(max<size_t>(refresh_frames, 1));
+	shown_frame_ms = static_cast<float>(refresh_frame_ms / frames);
+	shown_counters.draws = static_cast<size_t>(refresh_counters.draws / frames);
+	shown_counters.triangles = static_cast<size_t>(refresh_counters.triangles / frames);
+	shown_counters.state_changes = static_cast<size_t>(refresh_counters.state_changes / frames);
+	shown_counters.uploads = static_cast<size_t>(refresh_counters.uploads / frames);
+	shown_counters.upload_bytes = static_cast<size_t>(refresh_counters.upload_bytes / frames);
+
+	shown_gpu_ms = 0.0f;
+	for (auto &timer : timer_list)
+	{
+		timer.shown_cpu_ms = static_cast<float>(timer.total_cpu_ms / frames);
+		if (timer.gpu_results > 0)
+		{
+			timer.shown_gpu_ms = static_cast<float>(timer.total_gpu_ms / timer.gpu_results);
+		}
+		shown_gpu_ms += timer.shown_gpu_ms;
+
+		timer.total_cpu_ms = 0.0;
+		timer.total_gpu_ms = 0.0;
+		timer.gpu_results = 0;
+	}
+
+	refresh_frames = 0;
+	refresh_frame_ms = 0.0;
+	refresh_counters = Counters();
+}
+
+vector<int> Profiler::treeOrder() const
+{
+	vector<int> order;
+	addChildren(-1, order);
+	return order;
+}
+
+void Profiler::addChildren(int parent, vector<int> &order) const
+{
+	for (size_t i=0; i<timer_list.size(); i++)
+	{
+		if (timer_list[i].parent == parent)
+		{
+			order.push_back(static_cast<int>(i));
+			addChildren(static_cast<int>(i), order);
+		}
+	}
+}
+
+string Profiler::path(int timer) const
+{
+	const Timer &entry = timer_list[timer];
+	if (entry.parent < 0)
+	{
+		return entry.name;
+	}
+	return path(entry.parent) + "/" + entry.name;
+}
+
+vector<float> Profiler::recentFrames() const
+{
+	size_t first = frame_samples.size() - min<size_t>(frame_samples.size(), HistoryFrames);
+	return vector<float>(frame_samples.begin() + first, frame_samples.end());
+}
+
+vector<float> Profiler::recentGpuFrames() const
+{
+	size_t first = gpu_frame_samples.size() - min<size_t>(gpu_frame_samples.size(), HistoryFrames);
+	return vector<float>(gpu_frame_samples.begin() + first, gpu_frame_samples.end());
+}
+
+float Profiler::recentPercentile(float percent) const
+{
+	return percentile(recentFrames(), percent);
+}
+
+float Profiler::percentile(vector<float> samples, float percent)
+{
+	if (samples.empty())
+	{
+		return 0.0f;
+	}
+
+	// Nearest rank, so p100 is the maximum and p50 of two samples is the lower one
+	size_t rank = static_cast<size_t>(ceil(percent / 100.0f * samples.size()));
+	size_t index = min(max<size_t>(rank, 1), samples.size()) - 1;
+	nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+Profiler::Summary Profiler::summarise(const vector<float> &samples)
+{
+	Summary summary;
+	summary.samples = samples.size();
+	if (samples.empty())
+	{
+		return summary;
+	}
+
+	double total = 0.0;
+	for (float sample : samples)
+	{
+		total += sample;
+	}
+
+	summary.mean = static_cast<float>(total / samples.size());
+	summary.p50 = percentile(samples, 50.0f);
+	summary.p95 = percentile(samples, 95.0f);
+	summary.p99 = percentile(samples, 99.0f);
+	summary.max = *max_element(samples.begin(), samples.end());
+	return summary;
+}
+
+bool Profiler::writeCsv(const string &filename)
+{
+	readQueries(true);
+
+	ofstream file(filename);
+	if (!file)
+	{
+		cerr << "Unable to write profile " << filename << endl;
+		return false;
+	}
+
+	auto write_row = [&file](const string &metric, const char *unit, const vector<float> &samples)
+	{
+		Summary summary = summarise(samples);
+		file << metric << "," << unit << "," << summary.samples << "," << summary.mean << "," << summary.p50 << "," <<
+			summary.p95 << "," << summary.p99 << "," << summary.max << "\n";
+	};
+
+	file << "metric,unit,samples,mean,p50,p95,p99,max\n";
+	write_row("frame", "ms", frame_samples);
+	write_row("gpu frame", "ms", gpu_frame_samples);
+
+	for (int index : treeOrder())
+	{
+		const Timer &timer = timer_list[index];
+		write_row(path(index) + " cpu", "ms", timer.cpu_samples);
+		if (timer.gpu)
+		{
+			write_row(path(index) + " gpu", "ms", timer.gpu_samples);
+		}
+	}
+
+	vector<float> draws, triangles, state_changes, uploads, upload_bytes;
+	for (const auto &counters : counter_samples)
+	{
+		draws.push_back(static_cast<float>(counters.draws));
+		triangles.push_back(static_cast<float>(counters.triangles));
+		state_changes.push_back(static_cast<float>(counters.state_changes));
+		uploads.push_back(static_cast<float>(counters.uploads));
+		upload_bytes.push_back(static_cast<float>(counters.upload_bytes));
+	}
+
+	write_row("draw calls", "count", draws);
+	write_row("triangles", "count", triangles);
+	write_row("state changes", "count", state_changes);
+	write_row("uploads", "count", uploads);
+	write_row("upload bytes", "bytes", upload_bytes);
+
+	return true;
+}
@@ -0,0 +1,204 @@
+#ifndef __PROFILER_HPP__
+#define __PROFILER_HPP__
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+using namespace std;
+
+/**
+ * Frame profiler. Code is timed by PROFILE_SCOPE("name"), which lasts until the end of the
+ * enclosing block, and scopes opened inside another are timed as its children. PROFILE_GPU_SCOPE
+ * also wraps the GL commands issued in it in a GL_TIME_ELAPSED query, read back a few frames later
+ * so that timing never waits on the GPU. GL only runs one such query at a time, so a GPU scope
+ * inside another GPU scope, or entered a second time in a frame, is only timed on the CPU.
+ *
+ * Every frame is kept while profiling so that percentiles of the whole run can be written out,
+ * and the last HistoryFrames are kept for the HUD's graphs. Switched off, a scope is a test of one
+ * pointer, so scopes can stay in the render path.
+ */
+class Profiler
+{
+public:
+	/// Frames shown in the graphs and used for the HUD's percentiles.
+	static constexpr int HistoryFrames = 256;
+
+	/// Seconds between updates of the figures shown on the HUD, which are averages over that time.
+	static constexpr float RefreshSeconds = 0.5f;
+
+	/// GL work done in a frame.
+	struct Counters
+	{
+		size_t draws = 0;
+		size_t triangles = 0;
+		size_t state_changes = 0;
+		size_t uploads = 0;
+		size_t upload_bytes = 0;
+	};
+
+	/// Distribution of a measure over frames.
+	struct Summary
+	{
+		size_t samples = 0;
+		float mean = 0.0f;
+		float p50 = 0.0f;
+		float p95 = 0.0f;
+		float p99 = 0.0f;
+		float max = 0.0f;
+	};
+
+	/// A named scope, which is a child of the scope it was opened in.
+	struct Timer
+	{
+		const char *name = nullptr;
+		int parent = -1;
+		int depth = 0;
+		bool gpu = false;
+
+		// Averages shown on the HUD, in milliseconds
+		float shown_cpu_ms = 0.0f;
+		float shown_gpu_ms = 0.0f;
+
+		// Every frame since the scope was first entered, and every GPU result
+		vector<float> cpu_samples;
+		vector<float> gpu_samples;
+
+	private:
+		friend class Profiler;
+
+		static constexpr int QueryFrames = 4;
+
+		chrono::steady_clock::time_point start;
+		float frame_cpu_ms = 0.0f;
+		double total_cpu_ms = 0.0;
+		double total_gpu_ms = 0.0;
+		size_t gpu_results = 0;
+
+		// Ring of queries, each with the frame it was issued in or -1 when it has been read
+		GLuint queries[QueryFrames] = {};
+		long query_frames[QueryFrames] = { -1, -1, -1, -1 };
+	};
+
+	/// Times the enclosing block while a profiler is switched on.
+	class Scope
+	{
+	public:
+		Scope(const char *name, bool gpu = false) : profiler(active)
+		{
+			if (profiler)
+			{
+				profiler->begin(name, gpu);
+			}
+		}
+
+		~Scope()
+		{
+			if (profiler)
+			{
+				profiler->end();
+			}
+		}
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	private:
+		Profiler *profiler;
+	};
+
+	Profiler() {}
+	~Profiler();
+
+	Profiler(const Profiler &) = delete;
+	Profiler &operator=(const Profiler &) = delete;
+
+	/// Switch timing on or off. Call between frames.
+	void setEnabled(bool enabled);
+	bool isEnabled() const { return active == this; }
+
+	/// Mark the start and end of a frame. The frame time covers everything between them.
+	void beginFrame();
+	void endFrame(const Counters &counters);
+
+	/// Open and close a scope, normally through PROFILE_SCOPE.
+	void begin(const char *name, bool gpu);
+	void end();
+
+	const vector<Timer> &timers() const { return timer_list; }
+
+	/// Indices of the timers with every scope followed by its children, in the order they were
+	/// first entered.
+	vector<int> treeOrder() const;
+
+	/// Frames profiled so far.
+	size_t numFrames() const { return frame_samples.size(); }
+
+	/// Every frame profiled: its time and GPU time in milliseconds and its counters.
+	const vector<float> &frames() const { return frame_samples; }
+	const vector<float> &gpuFrames() const { return gpu_frame_samples; }
+	const vector<Counters> &counters() const { return counter_samples; }
+
+	/// Frame times in milliseconds of the last HistoryFrames frames, oldest first, and the GPU
+	/// time of the same frames, which is zero until their queries have been read.
+	vector<float> recentFrames() const;
+	vector<float> recentGpuFrames() const;
+
+	/// Averages over the last refresh, and frame time percentiles over the history.
+	const Counters &shownCounters() const { return shown_counters; }
+	float shownFrameMs() const { return shown_frame_ms; }
+	float shownGpuMs() const { return shown_gpu_ms; }
+	float recentPercentile(float percent) const;
+
+	/// Write the mean, p50, p95, p99 and maximum of the frame time, of every scope and of every
+	/// counter over all frames profiled. Waits for any GPU timings still outstanding.
+	bool writeCsv(const string &filename);
+
+	/// Value at a percentile of the samples, 0 when there are none.
+	static float percentile(vector<float> samples, float percent);
+	static Summary summarise(const vector<float> &samples);
+
+private:
+	void readQuery(Timer &timer, int slot, bool wait);
+	void readQueries(bool wait);
+	void refresh();
+	void addChildren(int parent, vector<int> &order) const;
+	string path(int timer) const;
+
+	inline static Profiler *active = nullptr;
+
+	vector<Timer> timer_list;
+	vector<int> stack;
+	int gpu_timer = -1;
+
+	chrono::steady_clock::time_point frame_start;
+	long frame = 0;
+
+	// All frames profiled
+	vector<float> frame_samples;
+	vector<float> gpu_frame_samples;
+	vector<Counters> counter_samples;
+
+	// Accumulated since the HUD figures were last refreshed
+	chrono::steady_clock::time_point last_refresh;
+	size_t refresh_frames = 0;
+	double refresh_frame_ms = 0.0;
+	Counters refresh_counters;
+
+	float shown_frame_ms = 0.0f;
+	float shown_gpu_ms = 0.0f;
+	Counters shown_counters;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// Time the rest of the enclosing block on the CPU, or on the CPU and the GPU
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(name, true)
+
+#endif // __PROFILER_HPP__
@@ -0,0 +1,280 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cctype>
+#include <cstddef>
+#include "profiler_hud.hpp"
+
+// Characters 32 to 95 as five rows of three pixels from the top, one octal digit per row with the
+// left pixel in the highest bit. Lower case letters are drawn as upper case.
+static const uint16_t font_glyphs[] = {
+	000000, 022202, 055000, 057575, 036236, 051245, 025257, 022000, // space ! " # $ % & '
+	012221, 042224, 005250, 002720, 000024, 000700, 000002, 011244, // ( ) * + , - . /
+	075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, // 0 - 7
+	075757, 075717, 002020, 002024, 012421, 007070, 042124, 071202, // 8 9 : ; < = > ?
+	025743, 025755, 065656, 034443, 065556, 074647, 074644, 034553, // @ A - G
+	055755, 072227, 011152, 055655, 044447, 057755, 065555, 025552, // H - O
+	065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775, // P - W
+	055255, 055222, 071247, 064446, 044211, 031113, 025000, 000007, // X Y Z [ \ ] ^ _
+	077777                                                          // Solid, for boxes
+};
+
+constexpr int FirstGlyph = 32;
+constexpr int NumGlyphs = sizeof(font_glyphs) / sizeof(font_glyphs[0]);
+constexpr int SolidGlyph = NumGlyphs - 1;
+
+// Short form of large numbers, e.g. 1.2M
+static string formatCount(double value)
+{
+	char text[32];
+	if (value >= 1.0e6)
+	{
+		snprintf(text, sizeof(text), "%.1fM", value / 1.0e6);
+	}
+	else if (value >= 1.0e3)
+	{
+		snprintf(text, sizeof(text), "%.1fK", value / 1.0e3);
+	}
+	else
+	{
+		snprintf(text, sizeof(text), "%.0f", value);
+	}
+	return text;
+}
+
+ProfilerHud::ProfilerHud(const AssetPack *pack) : program("res/hud_vertex_shader.glsl", "res/hud_fragment_shader.glsl", pack)
+{
+	if (!program.isValid())
+	{
+		cerr << "Unable to load the profiler HUD shaders, it won't be drawn\n";
+		return;
+	}
+
+	createFont();
+
+	glGenVertexArrays(1, &vertex_array_id);
+	glBindVertexArray(vertex_array_id);
+
+	glGenBuffers(1, &vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, colour));
+
+	glBindVertexArray(0);
+}
+
+ProfilerHud::~ProfilerHud()
+{
+	glDeleteBuffers(1, &vertex_buffer);
+	glDeleteVertexArrays(1, &vertex_array_id);
+	glDeleteTextures(1, &font_texture);
+}
+
+void ProfilerHud::createFont()
+{
+	// One row of glyph cells, a whole number of four byte rows wide so no unpack alignment is needed
+	int width = NumGlyphs * CellWidth;
+	vector<uint8_t> texels(width * GlyphHeight, 0);
+	for (int glyph=0; glyph<NumGlyphs; glyph++)
+	{
+		for (int row=0; row<GlyphHeight; row++)
+		{
+			int bits = (font_glyphs[glyph] >> (3 * (GlyphHeight - 1 - row))) & 7;
+			for (int column=0; column<GlyphWidth; column++)
+			{
+				if (bits & (4 >> column))
+				{
+					texels[row * width + glyph * CellWidth + column] = 255;
+				}
+			}
+		}
+	}
+
+	glGenTextures(1, &font_texture);
+	glActiveTexture(GL_TEXTURE0 + FontUnit);
+	glBindTexture(GL_TEXTURE_2D, font_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, GlyphHeight, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+}
+
+void ProfilerHud::addQuad(float x, float y, float w, float h, float u, float v, float texels_w, float texels_h, Colour colour)
+{
+	// Pixels from the top left to clip space
+	float left = x / screen_width * 2.0f - 1.0f;
+	float right = (x + w) / screen_width * 2.0f - 1.0f;
+	float top = 1.0f - y / screen_height * 2.0f;
+	float bottom = 1.0f - (y + h) / screen_height * 2.0f;
+
+	Vertex top_left = { left, top, u, v, colour };
+	Vertex top_right = { right, top, u + texels_w, v, colour };
+	Vertex bottom_left = { left, bottom, u, v + texels_h, colour };
+	Vertex bottom_right = { right, bottom, u + texels_w, v + texels_h, colour };
+
+	// Counter-clockwise on screen, so they survive face culling
+	vertices.push_back(top_left);
+	vertices.push_back(bottom_left);
+	vertices.push_back(top_right);
+	vertices.push_back(top_right);
+	vertices.push_back(bottom_left);
+	vertices.push_back(bottom_right);
+}
+
+void ProfilerHud::addBox(float x, float y, float w, float h, Colour colour)
+{
+	// Every fragment reads the middle of the solid glyph
+	float u = SolidGlyph * CellWidth + 1.5f;
+	float v = GlyphHeight / 2.0f;
+	addQuad(x, y, w, h, u, v, 0.0f, 0.0f, colour);
+}
+
+void ProfilerHud::addText(float x, float y, const char *text, Colour colour)
+{
+	for (const char *c=text; *c; c++, x+=CellWidth*Scale)
+	{
+		int code = toupper(static_cast<unsigned char>(*c));
+		if (code == ' ')
+		{
+			continue;
+		}
+		if (code < FirstGlyph || code >= FirstGlyph + SolidGlyph)
+		{
+			code = '?';
+		}
+
+		float u = static_cast<float>((code - FirstGlyph) * CellWidth);
+		addQuad(x, y, GlyphWidth * Scale, GlyphHeight * Scale, u, 0.0f, GlyphWidth, GlyphHeight, colour);
+	}
+}
+
+void ProfilerHud::addGraph(float x, float y, const vector<float> &frames, const char *label)
+{
+	addText(x, y, label, Colour{ 180, 180, 180, 255 });
+	y += LineHeight;
+
+	addBox(x, y, Profiler::HistoryFrames, GraphHeight, Colour{ 0, 0, 0, 128 });
+
+	// Newest frame on the right, green within 60 fps, yellow within 30 and red beyond that
+	float first = x + Profiler::HistoryFrames - frames.size();
+	for (size_t i=0; i<frames.size(); i++)
+	{
+		float ms = frames[i];
+		float height = min(ms / GraphMs, 1.0f) * GraphHeight;
+
+		Colour colour = { 80, 220, 80, 220 };
+		if (ms > 1000.0f / 30.0f)
+		{
+			colour = { 240, 60, 60, 220 };
+		}
+		else if (ms > 1000.0f / 60.0f)
+		{
+			colour = { 240, 220, 60, 220 };
+		}
+
+		addBox(first + i, y + GraphHeight - height, 1.0f, height, colour);
+	}
+
+	// Line at 60 fps
+	float target = GraphHeight - (1000.0f / 60.0f) / GraphMs * GraphHeight;
+	addBox(x, y + target, Profiler::HistoryFrames, 1.0f, Colour{ 255, 255, 255, 96 });
+}
+
+void ProfilerHud::draw(const Profiler &profiler, int width, int height)
+{
+	if (!program.isValid())
+	{
+		return;
+	}
+
+	screen_width = max(width, 1);
+	screen_height = max(height, 1);
+	vertices.clear();
+
+	vector<string> lines;
+	char line[128];
+
+	float frame_ms = profiler.shownFrameMs();
+	snprintf(line, sizeof(line), "Frame %6.2f ms  %5.0f fps", frame_ms, frame_ms > 0.0f ? 1000.0f / frame_ms : 0.0f);
+	lines.push_back(line);
+	snprintf(line, sizeof(line), "p50 %.2f  p95 %.2f  p99 %.2f ms", profiler.recentPercentile(50.0f),
+			 profiler.recentPercentile(95.0f), profiler.recentPercentile(99.0f));
+	lines.push_back(line);
+	snprintf(line, sizeof(line), "GPU   %6.2f ms", profiler.shownGpuMs());
+	lines.push_back(line);
+	lines.push_back("");
+
+	snprintf(line, sizeof(line), "%-22s %7s %7s", "Scope", "CPU ms", "GPU ms");
+	lines.push_back(line);
+	for (int index : profiler.treeOrder())
+	{
+		const Profiler::Timer &timer = profiler.timers()[index];
+		string name = string(timer.depth * 2, ' ') + timer.name;
+		if (timer.gpu)
+		{
+			snprintf(line, sizeof(line), "%-22.22s %7.2f %7.2f", name.c_str(), timer.shown_cpu_ms, timer.shown_gpu_ms);
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "%-22.22s %7.2f %7s", name.c_str(), timer.shown_cpu_ms, "-");
+		}
+		lines.push_back(line);
+	}
+	lines.push_back("");
+
+	const Profiler::Counters &counters = profiler.shownCounters();
+	lines.push_back("Draws " + formatCount(counters.draws) + "  Triangles " + formatCount(counters.triangles));
+	lines.push_back("State changes " + formatCount(counters.state_changes));
+	lines.push_back("Uploads " + formatCount(counters.uploads) + "  " + formatCount(counters.upload_bytes) + "B");
+
+	// Backing box around the text and both graphs
+	constexpr float margin = 8.0f;
+	constexpr float padding = 6.0f;
+	size_t columns = 0;
+	for (auto &text : lines)
+	{
+		columns = max(columns, text.size());
+	}
+
+	float box_width = max<float>(columns * CellWidth * Scale, Profiler::HistoryFrames) + 2.0f * padding;
+	float graph_height = LineHeight + GraphHeight + padding;
+	float box_height = lines.size() * LineHeight + 2.0f * graph_height + padding;
+	addBox(margin, margin, box_width, box_height, Colour{ 0, 0, 0, 160 });
+
+	float x = margin + padding;
+	float y = margin + padding;
+	for (auto &text : lines)
+	{
+		addText(x, y, text.c_str(), Colour{ 235, 235, 235, 255 });
+		y += LineHeight;
+	}
+
+	addGraph(x, y, profiler.recentFrames(), "CPU frame");
+	y += graph_height;
+	addGraph(x, y, profiler.recentGpuFrames(), "GPU frame");
+
+	program.use();
+	program.setUniform("Font", static_cast<int>(FontUnit));
+	glActiveTexture(GL_TEXTURE0 + FontUnit);
+	glBindTexture(GL_TEXTURE_2D, font_texture);
+
+	glBindVertexArray(vertex_array_id);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STREAM_DRAW);
+
+	// Over everything with the font's coverage as alpha, leaving the depth test on for the next frame
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+
+	glBindVertexArray(0);
+}
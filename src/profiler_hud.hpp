@@ -0,0 +1,77 @@
+#ifndef __PROFILER_HUD_HPP__
+#define __PROFILER_HUD_HPP__
+
+#include <vector>
+#include <cstdint>
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+#include "program.hpp"
+#include "profiler.hpp"
+#include "asset_pack.hpp"
+
+using namespace std;
+
+/**
+ * Overlay of a Profiler's figures: the frame time and its percentiles, the CPU and GPU time of
+ * every scope, the frame's GL counters and graphs of the recent CPU and GPU frame times. Text uses
+ * a built in 3x5 pixel font so nothing needs loading, and the whole overlay is one draw.
+ */
+class ProfilerHud
+{
+public:
+	ProfilerHud(const AssetPack *pack = nullptr);
+	~ProfilerHud();
+
+	ProfilerHud(const ProfilerHud &) = delete;
+	ProfilerHud &operator=(const ProfilerHud &) = delete;
+
+	/// Draw over the top left of a frame of the given size in pixels.
+	void draw(const Profiler &profiler, int width, int height);
+
+private:
+	struct Colour
+	{
+		uint8_t r, g, b, a;
+	};
+
+	struct Vertex
+	{
+		float x, y;
+		float u, v;
+		Colour colour;
+	};
+
+	// Texture unit the font is bound to, which nothing else uses
+	static constexpr GLuint FontUnit = 4;
+
+	// Glyphs are 3x5 texels, each in a cell one texel wider, drawn at twice their size
+	static constexpr int GlyphWidth = 3;
+	static constexpr int GlyphHeight = 5;
+	static constexpr int CellWidth = 4;
+	static constexpr int Scale = 2;
+	static constexpr int LineHeight = (GlyphHeight + 2) * Scale;
+
+	// Graphs are one pixel per frame and this tall for a frame of GraphMs
+	static constexpr int GraphHeight = 60;
+	static constexpr float GraphMs = 1000.0f / 30.0f;
+
+	void createFont();
+
+	void addQuad(float x, float y, float w, float h, float u, float v, float texels_w, float texels_h, Colour colour);
+	void addBox(float x, float y, float w, float h, Colour colour);
+	void addText(float x, float y, const char *text, Colour colour);
+	void addGraph(float x, float y, const vector<float> &frames, const char *label);
+
+	Program program;
+	GLuint font_texture = 0;
+	GLuint vertex_array_id = 0;
+	GLuint vertex_buffer = 0;
+
+	int screen_width = 1;
+	int screen_height = 1;
+	vector<Vertex> vertices;
+};
+
+#endif // __PROFILER_HUD_HPP__
@@ -0,0 +1,89 @@
+#include <iostream>
+#include "program.hpp"
+#include "utility.hpp"
+#include "gl_stats.hpp"
+
+Program::Program(const char *vertex_file_path, const char *fragment_file_path, const AssetPack *pack)
+{
+	const AssetPack::Entry *vertex = pack ? pack->find(vertex_file_path, AssetPack::TypeShader) : nullptr;
+	const AssetPack::Entry *fragment = pack ? pack->find(fragment_file_path, AssetPack::TypeShader) : nullptr;
+	if (vertex && fragment)
+	{
+		program_id = compile_shaders(reinterpret_cast<const char*>(pack->data(*vertex)), reinterpret_cast<const char*>(pack->data(*fragment)),
+									 vertex_file_path, fragment_file_path);
+		return;
+	}
+
+	program_id = load_shaders(vertex_file_path, fragment_file_path);
+}
+
+Program::~Program()
+{
+	if (current == program_id)
+	{
+		current = 0;
+	}
+
+	glDeleteProgram(program_id);
+}
+
+void Program::use()
+{
+	if (current != program_id)
+	{
+		GL_CALL(glUseProgram(program_id));
+		current = program_id;
+	}
+}
+
+GLint Program::uniform(const char *name)
+{
+	auto found = locations.find(name);
+	if (found != locations.end())
+	{
+		return found->second;
+	}
+
+	GLint location = glGetUniformLocation(program_id, name);
+	locations.emplace(name, location);
+	return location;
+}
+
+void Program::setUniform(const char *name, int value)
+{
+	GLint location = uniform(name);
+	if (location >= 0)
+	{
+		GL_CALL(glUniform1i(location, value));
+	}
+}
+
+void Program::setUniform(const char *name, const glm::vec3 &value)
+{
+	GLint location = uniform(name);
+	if (location >= 0)
+	{
+		GL_CALL(glUniform3fv(location, 1, &value[0]));
+	}
+}
+
+void Program::setUniform(const char *name, const glm::mat4 &value)
+{
+	GLint location = uniform(name);
+	if (location >= 0)
+	{
+		GL_CALL(glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]));
+	}
+}
+
+void Program::bindUniformBlock(const char *name, GLuint binding)
+{
+	GLuint index = glGetUniformBlockIndex(program_id, name);
+	if (index == GL_INVALID_INDEX)
+	{
+		cerr << "Uniform block " << name << " not found in program\n";
+		return;
+	}
+
+	glUniformBlockBinding(program_id, index, binding);
+}
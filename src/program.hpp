@@ -0,0 +1,56 @@
+#ifndef __PROGRAM_HPP__
+#define __PROGRAM_HPP__
+
+#include <string>
+#include <unordered_map>
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "asset_pack.hpp"
+
+using namespace std;
+
+/**
+ * A linked GLSL program. Uniform locations are looked up from GL the first time they are used
+ * and cached after that, and the program is only made current when it isn't already.
+ */
+class Program
+{
+public:
+	/// Compile shaders from files, or from the pack when it has both under the same paths.
+	Program(const char *vertex_file_path, const char *fragment_file_path, const AssetPack *pack = nullptr);
+	~Program();
+
+	Program(const Program &) = delete;
+	Program &operator=(const Program &) = delete;
+
+	/// False if the shaders failed to load, compile or link.
+	bool isValid() const { return program_id != 0; }
+	GLuint id() const { return program_id; }
+
+	void use();
+
+	/// Location of a uniform, -1 if the program doesn't have it.
+	GLint uniform(const char *name);
+
+	/// Set a uniform in this program, which must be current. Unknown names are ignored.
+	void setUniform(const char *name, int value);
+	void setUniform(const char *name, const glm::vec3 &value);
+	void setUniform(const char *name, const glm::mat4 &value);
+
+	/// Attach a uniform block in the shaders to a uniform buffer binding point.
+	void bindUniformBlock(const char *name, GLuint binding);
+
+private:
+	GLuint program_id;
+	unordered_map<string, GLint> locations;
+
+	inline static GLuint current = 0;
+};
+
+#endif // __PROGRAM_HPP__
@@ -0,0 +1,37 @@
+#include <vector>
+#include "quad_indices.hpp"
+
+using namespace std;
+
+void QuadIndices::bind(size_t num_quads)
+{
+	if (buffer_id == 0)
+	{
+		glGenBuffers(1, &buffer_id);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer_id);
+
+	if (num_quads <= capacity)
+	{
+		return;
+	}
+
+	// Grow to at least double so repeated binds don't keep rebuilding the buffer
+	capacity = max(num_quads, capacity * 2);
+
+	vector<GLuint> indices;
+	indices.reserve(numIndices(capacity));
+	for (GLuint quad=0; quad<capacity; quad++)
+	{
+		GLuint base = quad * VerticesPerQuad;
+		indices.push_back(base + 0);
+		indices.push_back(base + 1);
+		indices.push_back(base + 2);
+		indices.push_back(base + 2);
+		indices.push_back(base + 1);
+		indices.push_back(base + 3);
+	}
+
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+}
@@ -0,0 +1,31 @@
+#ifndef __QUAD_INDICES_HPP__
+#define __QUAD_INDICES_HPP__
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+#include <cstddef>
+
+/**
+ * Shared element buffer for drawing lists of quads, where each quad is four vertices in the
+ * order top-left, bottom-left, top-right, bottom-right. The buffer is built once and grown in
+ * place so every vertex array object that has it bound stays valid.
+ */
+class QuadIndices
+{
+public:
+	/// Bind the shared buffer to the current vertex array, making sure it covers num_quads.
+	static void bind(size_t num_quads);
+
+	/// Number of indices needed to draw num_quads.
+	static size_t numIndices(size_t num_quads) { return num_quads * IndicesPerQuad; }
+
+	static constexpr size_t VerticesPerQuad = 4;
+	static constexpr size_t IndicesPerQuad = 6;
+
+private:
+	inline static GLuint buffer_id = 0;
+	inline static size_t capacity = 0;
+};
+
+#endif // __QUAD_INDICES_HPP__
@@ -0,0 +1,401 @@
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "region_file.hpp"
+
+static const char RegionMagic[4] = { 'O', 'R', 'B', 'R' };
+
+RegionFile::RegionFile(const string &path) : path(path)
+{
+	fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		cerr << "Unable to open region " << path << ": " << strerror(errno) << endl;
+		return;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		cerr << "Unable to read the size of region " << path << ": " << strerror(errno) << endl;
+		return;
+	}
+
+	size_t file_size = static_cast<size_t>(info.st_size);
+	bool created = file_size == 0;
+	if (created)
+	{
+		file_size = SectorSize;
+	}
+	else if (file_size < SectorSize || file_size % SectorSize != 0)
+	{
+		cerr << "Region " << path << " is not a whole number of sectors\n";
+		return;
+	}
+
+	if (!map(file_size))
+	{
+		return;
+	}
+
+	if (created)
+	{
+		memcpy(header()->magic, RegionMagic, sizeof(RegionMagic));
+		header()->version = Version;
+		header()->region_size = Size;
+		header()->chunk_size = ChunkSize;
+	}
+	else if (memcmp(header()->magic, RegionMagic, sizeof(RegionMagic)) != 0 || header()->version != Version ||
+			 header()->region_size != Size || header()->chunk_size != ChunkSize)
+	{
+		cerr << "Region " << path << " is not a version " << Version << " region file\n";
+		unmap();
+		return;
+	}
+
+	// Mark the sectors in use so that free ones can be handed out again
+	used.assign(mapped_size / SectorSize, false);
+	used[0] = true;
+	for (auto &entry : header()->locations)
+	{
+		size_t first = entry >> 8;
+		size_t count = entry & 0xff;
+		if (entry != 0 && (first == 0 || count == 0 || first + count > used.size()))
+		{
+			cerr << "Region " << path << " has a chunk outside of the file, dropping it\n";
+			entry = 0;
+			continue;
+		}
+
+		for (size_t sector=first; sector<first+count; sector++)
+		{
+			used[sector] = true;
+		}
+	}
+}
+
+RegionFile::~RegionFile()
+{
+	unmap();
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+}
+
+bool RegionFile::map(size_t new_size)
+{
+	// A failed resize goes back to the old size, so the chunks already in the region can still be read
+	size_t old_size = mapped_size;
+	unmap();
+
+	if (ftruncate(fd, static_cast<off_t>(new_size)) != 0)
+	{
+		cerr << "Unable to resize region " << path << ": " << strerror(errno) << endl;
+	}
+	else if (mapFile(new_size))
+	{
+		return true;
+	}
+
+	if (old_size != 0 && (ftruncate(fd, static_cast<off_t>(old_size)) != 0 || !mapFile(old_size)))
+	{
+		cerr << "Unable to restore region " << path << ", its chunks can no longer be read\n";
+	}
+	return false;
+}
+
+bool RegionFile::mapFile(size_t size)
+{
+	void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED)
+	{
+		cerr << "Unable to map region " << path << ": " << strerror(errno) << endl;
+		return false;
+	}
+
+	data = static_cast<uint8_t*>(mapping);
+	mapped_size = size;
+	return true;
+}
+
+void RegionFile::unmap()
+{
+	if (data)
+	{
+		munmap(data, mapped_size);
+		data = nullptr;
+		mapped_size = 0;
+	}
+}
+
+size_t RegionFile::numUsedSectors() const
+{
+	size_t count = 0;
+	for (bool sector : used)
+	{
+		count += sector;
+	}
+	return count;
+}
+
+size_t RegionFile::allocate(size_t count)
+{
+	// First run of free sectors that is long enough
+	size_t run = 0;
+	for (size_t sector=1; sector<used.size(); sector++)
+	{
+		run = used[sector] ? 0 : run + 1;
+		if (run == count)
+		{
+			return sector + 1 - count;
+		}
+	}
+
+	// Otherwise grow the file, taking in any free sectors at its end
+	size_t first = used.size() - run;
+	if (!map((first + count) * SectorSize))
+	{
+		return 0;
+	}
+	used.resize(first + count, false);
+	return first;
+}
+
+void RegionFile::release(uint32_t entry)
+{
+	size_t first = entry >> 8;
+	size_t count = entry & 0xff;
+	for (size_t sector=first; sector<first+count; sector++)
+	{
+		used[sector] = false;
+	}
+}
+
+bool RegionFile::read(int x, int y, int z, vector<int32_t> &voxels) const
+{
+	if (!isValid())
+	{
+		return false;
+	}
+
+	uint32_t entry = location(x, y, z);
+	if (entry == 0)
+	{
+		return false;
+	}
+
+	const uint8_t *sector = data + static_cast<size_t>(entry >> 8) * SectorSize;
+	ChunkHeader chunk;
+	memcpy(&chunk, sector, sizeof(chunk));
+
+	if (sizeof(chunk) + chunk.length > (entry & 0xff) * SectorSize || !decode(sector + sizeof(chunk), chunk, voxels))
+	{
+		cerr << "Chunk (" << x << ", " << y << ", " << z << ") of region " << path << " is corrupt\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool RegionFile::write(int x, int y, int z, const vector<int32_t> &voxels)
+{
+	if (!isValid() || voxels.size() != ChunkVoxels)
+	{
+		return false;
+	}
+
+	ChunkHeader chunk = {};
+	vector<uint8_t> encoded;
+	encode(voxels, encoded, chunk);
+	chunk.length = static_cast<uint32_t>(encoded.size());
+
+	size_t count = (sizeof(chunk) + encoded.size() + SectorSize - 1) / SectorSize;
+	if (count > MaxChunkSectors)
+	{
+		cerr << "Chunk (" << x << ", " << y << ", " << z << ") is too large for region " << path << endl;
+		return false;
+	}
+
+	// Rewrite in place when the chunk still fits, handing back any sectors it no longer needs
+	uint32_t entry = location(x, y, z);
+	size_t first = entry >> 8;
+	size_t old_count = entry & 0xff;
+	if (entry != 0 && count <= old_count)
+	{
+		for (size_t sector=first+count; sector<first+old_count; sector++)
+		{
+			used[sector] = false;
+		}
+	}
+	else
+	{
+		// The old copy is only let go once there is somewhere else for the chunk, so a failed write
+		// leaves it as it was
+		first = allocate(count);
+		if (first == 0)
+		{
+			return false;
+		}
+		release(entry);
+	}
+
+	for (size_t sector=first; sector<first+count; sector++)
+	{
+		used[sector] = true;
+	}
+
+	uint8_t *sector = data + first * SectorSize;
+	memcpy(sector, &chunk, sizeof(chunk));
+	memcpy(sector + sizeof(chunk), encoded.data(), encoded.size());
+
+	header()->locations[index(x, y, z)] = static_cast<uint32_t>((first << 8) | count);
+	return true;
+}
+
+void RegionFile::erase(int x, int y, int z)
+{
+	if (!isValid())
+	{
+		return;
+	}
+
+	uint32_t &entry = header()->locations[index(x, y, z)];
+	release(entry);
+	entry = 0;
+}
+
+void RegionFile::encode(const vector<int32_t> &voxels, vector<uint8_t> &encoded, ChunkHeader &chunk)
+{
+	// Each value in the chunk is stored once in a palette, in the order it first appears, and
+	// voxels hold indices into it. Chunks rarely hold more than a few types, so indices are
+	// usually a single byte.
+	vector<int32_t> palette;
+	unordered_map<int32_t, uint16_t> entries;
+	vector<uint16_t> indices(voxels.size());
+	for (size_t i=0; i<voxels.size(); i++)
+	{
+		auto found = entries.find(voxels[i]);
+		if (found == entries.end())
+		{
+			found = entries.emplace(voxels[i], static_cast<uint16_t>(palette.size())).first;
+			palette.push_back(voxels[i]);
+		}
+		indices[i] = found->second;
+	}
+
+	chunk.palette_size = static_cast<uint16_t>(palette.size());
+	chunk.index_size = palette.size() <= 256 ? 1 : 2;
+
+	encoded.resize(palette.size() * sizeof(int32_t));
+	memcpy(encoded.data(), palette.data(), encoded.size());
+	size_t palette_bytes = encoded.size();
+
+	auto add_index = [&encoded, &chunk](uint16_t index)
+	{
+		encoded.push_back(static_cast<uint8_t>(index));
+		if (chunk.index_size == 2)
+		{
+			encoded.push_back(static_cast<uint8_t>(index >> 8));
+		}
+	};
+
+	// Whole rows of a chunk are usually the same, so runs are long
+	for (size_t i=0; i<indices.size(); )
+	{
+		size_t run = 1;
+		while (i + run < indices.size() && run < 256 && indices[i + run] == indices[i])
+		{
+			run++;
+		}
+
+		encoded.push_back(static_cast<uint8_t>(run - 1));
+		add_index(indices[i]);
+		i += run;
+	}
+	chunk.encoding = EncodingRunLength;
+
+	// Noisy chunks are smaller as they are
+	if (encoded.size() - palette_bytes > indices.size() * chunk.index_size)
+	{
+		encoded.resize(palette_bytes);
+		for (uint16_t index : indices)
+		{
+			add_index(index);
+		}
+		chunk.encoding = EncodingRaw;
+	}
+}
+
+bool RegionFile::decode(const uint8_t *encoded, const ChunkHeader &chunk, vector<int32_t> &voxels)
+{
+	size_t palette_bytes = chunk.palette_size * sizeof(int32_t);
+	if (chunk.palette_size == 0 || (chunk.index_size != 1 && chunk.index_size != 2) || chunk.length < palette_bytes)
+	{
+		return false;
+	}
+
+	vector<int32_t> palette(chunk.palette_size);
+	memcpy(palette.data(), encoded, palette_bytes);
+	encoded += palette_bytes;
+	size_t length = chunk.length - palette_bytes;
+
+	// Reads the index at the given byte, false if it is outside of the palette
+	auto read_index = [&encoded, &chunk](size_t at, uint16_t &index)
+	{
+		index = encoded[at];
+		if (chunk.index_size == 2)
+		{
+			index |= static_cast<uint16_t>(encoded[at + 1] << 8);
+		}
+		return index < chunk.palette_size;
+	};
+
+	voxels.resize(ChunkVoxels);
+	uint16_t index;
+
+	if (chunk.encoding == EncodingRaw)
+	{
+		if (length != ChunkVoxels * chunk.index_size)
+		{
+			return false;
+		}
+
+		for (size_t i=0; i<ChunkVoxels; i++)
+		{
+			if (!read_index(i * chunk.index_size, index))
+			{
+				return false;
+			}
+			voxels[i] = palette[index];
+		}
+		return true;
+	}
+
+	size_t pair_size = 1 + chunk.index_size;
+	if (chunk.encoding != EncodingRunLength || length % pair_size != 0)
+	{
+		return false;
+	}
+
+	size_t filled = 0;
+	for (size_t i=0; i<length; i+=pair_size)
+	{
+		size_t run = static_cast<size_t>(encoded[i]) + 1;
+		if (filled + run > ChunkVoxels || !read_index(i + 1, index))
+		{
+			return false;
+		}
+
+		fill(voxels.begin() + filled, voxels.begin() + filled + run, palette[index]);
+		filled += run;
+	}
+
+	return filled == ChunkVoxels;
+}
@@ -0,0 +1,122 @@
+#ifndef __REGION_FILE_HPP__
+#define __REGION_FILE_HPP__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * A file holding a cube of Size x Size x Size chunks, read and written through a memory mapping.
+ *
+ * The file is made of SectorSize byte sectors. The first is a header with a table giving the first
+ * sector and sector count of every chunk, so opening a region only maps it and loading a chunk
+ * only touches its own pages. Each chunk is stored run length encoded in whole sectors, and
+ * rewriting one reuses its sectors when it still fits, otherwise it moves to free sectors or the
+ * end of the file. Nothing else in the file is rewritten.
+ *
+ * Like BlockStorage, each chunk keeps a palette of the 32 bit values it holds and stores its
+ * voxels as one or two byte indices into it, so the number of block types isn't limited by the
+ * format.
+ *
+ * Voxels are passed around as one value per voxel in the order BlockInstance stores them
+ * (x fastest, then y, then z) with -1 for empty, so this has no GL dependencies and can be used
+ * by tools.
+ */
+class RegionFile
+{
+public:
+	static constexpr int Size = 8;
+	static constexpr int ChunkSize = 16;
+	static constexpr size_t ChunkVoxels = ChunkSize * ChunkSize * ChunkSize;
+	static constexpr size_t SectorSize = 4096;
+
+	/// Name of the file for the region at the given region coordinates, e.g. "r.0.0.0.region".
+	static string fileName(int x, int y, int z)
+	{
+		return "r." + to_string(x) + "." + to_string(y) + "." + to_string(z) + ".region";
+	}
+
+	/// Open a region, creating an empty one if the file doesn't exist.
+	RegionFile(const string &path);
+	~RegionFile();
+
+	RegionFile(const RegionFile &) = delete;
+	RegionFile &operator=(const RegionFile &) = delete;
+
+	bool isValid() const { return data != nullptr; }
+
+	/// Chunk coordinates are local to the region, 0 to Size - 1 along each axis.
+	bool contains(int x, int y, int z) const { return location(x, y, z) != 0; }
+
+	/// Decode a chunk into ChunkVoxels voxels. False if the chunk isn't stored.
+	bool read(int x, int y, int z, vector<int32_t> &voxels) const;
+
+	/// Store a chunk of ChunkVoxels voxels, replacing any earlier copy of it.
+	bool write(int x, int y, int z, const vector<int32_t> &voxels);
+
+	/// Drop a chunk from the region, freeing its sectors.
+	void erase(int x, int y, int z);
+
+	/// Sectors in the file including the header, and those holding chunks.
+	size_t numSectors() const { return used.size(); }
+	size_t numUsedSectors() const;
+
+private:
+	// Sector 0. Each location is the first sector of a chunk shifted up by 8 bits plus its sector count, zero when not stored.
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t region_size;
+		uint32_t chunk_size;
+		uint32_t locations[Size * Size * Size];
+	};
+
+	static_assert(sizeof(Header) <= SectorSize, "Region header must fit in one sector");
+
+	// Start of a chunk's first sector, followed by the palette's values and then the encoded indices
+	struct ChunkHeader
+	{
+		uint32_t length;        // Bytes of palette and encoded indices following this header
+		uint8_t encoding;       // One of Encoding
+		uint8_t index_size;     // Bytes in each index, 1 or 2
+		uint16_t palette_size;  // Number of int32_t values in the palette
+	};
+
+	static_assert(ChunkVoxels <= 0xffff, "Palette indices must fit in two bytes");
+
+	enum Encoding
+	{
+		EncodingRaw = 0,       // One index per voxel
+		EncodingRunLength = 1  // Pairs of run length minus one, as a byte, and index
+	};
+
+	static constexpr uint32_t Version = 2;
+	static constexpr size_t MaxChunkSectors = 255;
+
+	static int index(int x, int y, int z) { return (z * Size + y) * Size + x; }
+	uint32_t location(int x, int y, int z) const { return header()->locations[index(x, y, z)]; }
+
+	Header *header() const { return reinterpret_cast<Header*>(data); }
+	bool map(size_t new_size);
+	bool mapFile(size_t size);
+	void unmap();
+	size_t allocate(size_t count);
+	void release(uint32_t location);
+
+	static void encode(const vector<int32_t> &voxels, vector<uint8_t> &encoded, ChunkHeader &chunk);
+	static bool decode(const uint8_t *encoded, const ChunkHeader &chunk, vector<int32_t> &voxels);
+
+	string path;
+	int fd = -1;
+	uint8_t *data = nullptr;
+	size_t mapped_size = 0;
+
+	// Which sectors hold the header or a chunk, rebuilt from the location table on open
+	vector<bool> used;
+};
+
+#endif // __REGION_FILE_HPP__
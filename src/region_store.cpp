@@ -0,0 +1,131 @@
+#include <iostream>
+#include <sys/stat.h>
+#include "region_store.hpp"
+
+static_assert(RegionFile::ChunkSize == BLOCK_WIDTH && RegionFile::ChunkSize == BLOCK_HEIGHT && RegionFile::ChunkSize == BLOCK_DEPTH,
+			  "Region chunks must be the size of a block");
+
+// Rounds towards negative infinity so that regions line up across zero
+static int floorDiv(int value, int divisor)
+{
+	return (value >= 0 ? value : value - divisor + 1) / divisor;
+}
+
+RegionStore::RegionStore(const string &directory) : directory(directory)
+{
+}
+
+ChunkCoord RegionStore::regionOf(const ChunkCoord &coord, ChunkCoord &local)
+{
+	ChunkCoord region = { floorDiv(coord.x, RegionFile::Size), floorDiv(coord.y, RegionFile::Size), floorDiv(coord.z, RegionFile::Size) };
+	local = { coord.x - region.x * RegionFile::Size, coord.y - region.y * RegionFile::Size, coord.z - region.z * RegionFile::Size };
+	return region;
+}
+
+RegionFile *RegionStore::region(const ChunkCoord &coord, bool create)
+{
+	auto found = regions.find(coord);
+	if (found != regions.end() && (found->second || !create))
+	{
+		return found->second.get();
+	}
+
+	string path = directory + "/" + RegionFile::fileName(coord.x, coord.y, coord.z);
+
+	struct stat info;
+	if (!create && stat(path.c_str(), &info) != 0)
+	{
+		regions[coord] = nullptr;
+		return nullptr;
+	}
+
+	auto opened = make_unique<RegionFile>(path);
+	if (!opened->isValid())
+	{
+		opened.reset();
+	}
+
+	RegionFile *file = opened.get();
+	regions[coord] = move(opened);
+	return file;
+}
+
+void RegionStore::load(const ChunkCoord &coord, BlockInstance &block)
+{
+	ChunkCoord local;
+	ChunkCoord region_coord = regionOf(coord, local);
+
+	vector<int32_t> voxels;
+	{
+		lock_guard<mutex> guard(lock);
+		RegionFile *file = region(region_coord, false);
+		if (!file || !file->read(local.x, local.y, local.z, voxels))
+		{
+			return;
+		}
+	}
+
+	// A world saved by a build with more block types can't be drawn by this one
+	for (int32_t voxel : voxels)
+	{
+		if (voxel < BlockInstance::Empty || voxel >= BlockInstance::MaxBlocks)
+		{
+			cerr << "Chunk (" << coord.x << ", " << coord.y << ", " << coord.z << ") holds unknown block type " << voxel << ", leaving it empty\n";
+			return;
+		}
+	}
+
+	size_t i = 0;
+	for (int z=0; z<BLOCK_DEPTH; z++)
+	{
+		for (int y=0; y<BLOCK_HEIGHT; y++)
+		{
+			for (int x=0; x<BLOCK_WIDTH; x++, i++)
+			{
+				if (voxels[i] != BlockInstance::Empty)
+				{
+					block.setBit(x, y, z, static_cast<BlockInstance::Block>(voxels[i]));
+				}
+			}
+		}
+	}
+}
+
+bool RegionStore::save(const ChunkCoord &coord, const BlockInstance &block)
+{
+	ChunkCoord local;
+	ChunkCoord region_coord = regionOf(coord, local);
+	lock_guard<mutex> guard(lock);
+
+	// Empty blocks are simply left out, so there is no need for a region to hold them
+	if (block.isEmpty())
+	{
+		RegionFile *file = region(region_coord, false);
+		if (file)
+		{
+			file->erase(local.x, local.y, local.z);
+		}
+		return true;
+	}
+
+	RegionFile *file = region(region_coord, true);
+	if (!file)
+	{
+		return false;
+	}
+
+	vector<int32_t> voxels(RegionFile::ChunkVoxels);
+	size_t i = 0;
+	for (int z=0; z<BLOCK_DEPTH; z++)
+	{
+		for (int y=0; y<BLOCK_HEIGHT; y++)
+		{
+			for (int x=0; x<BLOCK_WIDTH; x++, i++)
+			{
+				voxels[i] = block.getBit(x, y, z);
+			}
+		}
+	}
+
+	return file->write(local.x, local.y, local.z, voxels);
+}
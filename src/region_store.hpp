@@ -0,0 +1,45 @@
+#ifndef __REGION_STORE_HPP__
+#define __REGION_STORE_HPP__
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+
+#include "chunk_manager.hpp"
+#include "region_file.hpp"
+
+using namespace std;
+
+/**
+ * A world saved as a directory of region files, one for each cube of RegionFile::Size chunks.
+ * Regions are opened the first time one of their chunks is asked for and then stay mapped.
+ * Loading and saving can be called from different threads.
+ */
+class RegionStore
+{
+public:
+	RegionStore(const string &directory);
+
+	/// Fill a block from disk, leaving it empty if it was never saved. Fits ChunkManager::ChunkSource.
+	void load(const ChunkCoord &coord, BlockInstance &block);
+
+	/// Write a block back to its region, only touching that block's sectors. False if it couldn't
+	/// be written. Fits ChunkManager::ChunkSink.
+	bool save(const ChunkCoord &coord, const BlockInstance &block);
+
+	/// Region holding a chunk and the chunk's coordinates within it.
+	static ChunkCoord regionOf(const ChunkCoord &coord, ChunkCoord &local);
+
+private:
+	// Only regions that are written to are created on disk. Missing ones are remembered as nullptr.
+	RegionFile *region(const ChunkCoord &coord, bool create);
+
+	string directory;
+
+	// Saving can grow and remap a region that is being read from
+	mutex lock;
+	unordered_map<ChunkCoord, unique_ptr<RegionFile>, ChunkCoordHash> regions;
+};
+
+#endif // __REGION_STORE_HPP__
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstring>
+#include "render_queue.hpp"
+#include "gl_stats.hpp"
+
+uint64_t RenderQueue::makeKey(Pass pass, GLuint program_id, GLuint texture_id, float depth, float max_depth)
+{
+	constexpr uint64_t depth_range = (1 << 24) - 1;
+	float scaled = max(0.0f, min(depth / max_depth, 1.0f)) * depth_range;
+
+	return (static_cast<uint64_t>(pass & 0xf) << 60) |
+		(static_cast<uint64_t>(program_id & 0xfff) << 48) |
+		(static_cast<uint64_t>(texture_id & 0xfff) << 36) |
+		(static_cast<uint64_t>(scaled) << 12);
+}
+
+void RenderQueue::submit(DrawPacket packet, float depth, Pass pass)
+{
+	packet.key = makeKey(pass, packet.program ? packet.program->id() : 0, packet.texture ? packet.texture->id() : 0, depth);
+	packets.push_back(move(packet));
+}
+
+void RenderQueue::applyUniforms(DrawPacket &packet)
+{
+	static const char *flag_names[DrawPacket::MaxFlags] = { "Tiled_UV", "Packed_Vertex", "Shared_Geometry", "Instanced" };
+
+	ProgramState &state = program_states[packet.program];
+
+	for (int flag=0; flag<DrawPacket::MaxFlags; flag++)
+	{
+		unsigned bit = 1 << flag;
+		if (state.known && (state.flags & bit) == (packet.flags & bit))
+		{
+			counters.skipped++;
+			continue;
+		}
+
+		packet.program->setUniform(flag_names[flag], (packet.flags & bit) ? GL_TRUE : GL_FALSE);
+		counters.changes++;
+	}
+
+	// Instanced draws take their model matrices from an attribute
+	if (!(packet.flags & DrawPacket::FlagInstanced))
+	{
+		if (state.known && memcmp(&state.model, &packet.model, sizeof(glm::mat4)) == 0)
+		{
+			counters.skipped++;
+		}
+		else
+		{
+			packet.program->setUniform("M", packet.model);
+			state.model = packet.model;
+			counters.changes++;
+		}
+	}
+
+	state.flags = packet.flags;
+	state.known = true;
+}
+
+void RenderQueue::flush()
+{
+	counters = Stats();
+	counters.packets = packets.size();
+
+	// Sort the keys rather than the packets to save moving the packets around
+	order.clear();
+	for (uint32_t i=0; i<packets.size(); i++)
+	{
+		order.emplace_back(packets[i].key, i);
+	}
+	sort(order.begin(), order.end());
+
+	Program *program = nullptr;
+	Texture *texture = nullptr;
+	GLuint vertex_array_id = 0;
+	bool first = true;
+
+	for (const auto &entry : order)
+	{
+		DrawPacket &packet = packets[entry.second];
+
+		if (first || packet.program != program)
+		{
+			packet.program->use();
+			program = packet.program;
+			counters.changes++;
+		}
+		else
+		{
+			counters.skipped++;
+		}
+
+		applyUniforms(packet);
+
+		if (packet.texture)
+		{
+			if (packet.texture != texture)
+			{
+				packet.texture->bind();
+				texture = packet.texture;
+				counters.changes++;
+			}
+			else
+			{
+				counters.skipped++;
+			}
+		}
+
+		if (first || packet.vertex_array_id != vertex_array_id)
+		{
+			GL_CALL(glBindVertexArray(packet.vertex_array_id));
+			vertex_array_id = packet.vertex_array_id;
+			counters.changes++;
+		}
+		else
+		{
+			counters.skipped++;
+		}
+
+		first = false;
+		packet.draw();
+	}
+
+	if (!packets.empty())
+	{
+		GL_CALL(glBindVertexArray(0));
+	}
+
+	packets.clear();
+}
@@ -0,0 +1,96 @@
+#ifndef __RENDER_QUEUE_HPP__
+#define __RENDER_QUEUE_HPP__
+
+#include <vector>
+#include <map>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+// Include GLM
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "program.hpp"
+#include "texture.hpp"
+
+using namespace std;
+
+/**
+ * Everything needed to make one draw: the GL state it needs, its per-draw uniforms and the call
+ * that draws it once that state is in place.
+ */
+struct DrawPacket
+{
+	// Shader switches, each mapping to a bool uniform
+	enum Flags
+	{
+		FlagTiledUV = 1 << 0,        // Tiled_UV
+		FlagPackedVertex = 1 << 1,   // Packed_Vertex
+		FlagSharedGeometry = 1 << 2, // Shared_Geometry
+		FlagInstanced = 1 << 3,      // Instanced
+		MaxFlags = 4
+	};
+
+	uint64_t key = 0;
+	Program *program = nullptr;
+	Texture *texture = nullptr;
+	GLuint vertex_array_id = 0;
+	unsigned flags = 0;
+	glm::mat4 model = glm::mat4(1);
+	function<void()> draw;
+};
+
+/**
+ * Per-frame list of draw packets. Packets are sorted by their key, which orders them by pass,
+ * then program, then texture and then front to back, and on flush only the state that differs
+ * from the previous packet is applied.
+ */
+class RenderQueue
+{
+public:
+	enum Pass
+	{
+		PassOpaque = 0,
+		PassTransparent = 1
+	};
+
+	struct Stats
+	{
+		size_t packets = 0;
+		size_t changes = 0; // Program, texture, vertex array and uniform changes made
+		size_t skipped = 0; // Changes not needed because the state was already in place
+	};
+
+	/// Sort key: 4 bits of pass, 12 of program, 12 of texture then 24 of depth (0 to max_depth).
+	static uint64_t makeKey(Pass pass, GLuint program_id, GLuint texture_id, float depth, float max_depth = 256.0f);
+
+	/// Add a packet, filling in its key from its program and texture.
+	void submit(DrawPacket packet, float depth, Pass pass = PassOpaque);
+
+	/// Sort and draw everything submitted since the last flush.
+	void flush();
+
+	const Stats &stats() const { return counters; }
+
+private:
+	// Uniform values last set in each program, which GL keeps between frames
+	struct ProgramState
+	{
+		bool known = false;
+		unsigned flags = 0;
+		glm::mat4 model = glm::mat4(1);
+	};
+
+	void applyUniforms(DrawPacket &packet);
+
+	vector<DrawPacket> packets;
+	vector<pair<uint64_t, uint32_t>> order;
+	map<Program*, ProgramState> program_states;
+	Stats counters;
+};
+
+#endif // __RENDER_QUEUE_HPP__
@@ -1,168 +1,234 @@
-#include <png.h>
-#include <zlib.h>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 #include "texture.hpp"
+#include "image.hpp"
+#include "texture_loader.hpp"
+#include "gl_stats.hpp"
 
 using namespace std;
 
-Texture::Texture(const char *filename, GLuint unit, bool linearfiltering) : unit(unit), linearfiltering(linearfiltering)
+Texture::Texture(const char *filename, GLuint unit, bool linearfiltering, const AssetPack *pack, TextureLoader *loader) :
+	linearfiltering(linearfiltering), unit(unit)
 {
-	id = load_png(filename);
+	load(filename, pack, loader);
 }
 
-Texture::~Texture()
-{
-	glDeleteTextures(1, &id);
-}
-	
-void Texture::setUniform(GLuint program_id, const char *name)
-{
-	uniform_id = glGetUniformLocation(program_id, name);
-	glUniform1i(uniform_id, unit);
-}
-
-void Texture::bind()
+Texture::Texture(const char *filename, int cell_size, const vector<int> &cells, GLuint unit, bool linearfiltering,
+				 const AssetPack *pack, TextureLoader *loader) :
+	linearfiltering(linearfiltering), unit(unit), texture_target(GL_TEXTURE_2D_ARRAY), cell_size(cell_size), cells(cells)
 {
-	glActiveTexture(GL_TEXTURE0 + unit);
-	glBindTexture(GL_TEXTURE_2D, id);
+	load(filename, pack, loader);
 }
 
-GLuint Texture::load_png(const char*filename)
+Texture::~Texture()
 {
-	const int header_size = 8;
-	unsigned char header[header_size];
-
-	// Open the file and check it has a PNG signature
-	FILE *file = fopen(filename, "rb");
-	if (!file)
+	if (loader)
 	{
-		cerr << "Image could not be opened: " << filename << endl;
-		return 0;
+		loader->cancel(*this);
 	}
 
-	if (fread(header, 1, header_size, file) != header_size)
+	// GL may hand the name out again
+	replace(begin(bound), end(bound), texture_id, 0u);
+
+	if (ready)
 	{
-		cerr << "Failed to read PNG header bytes\n";
-		return 0;
+		glDeleteTextures(1, &texture_id);
 	}
-	
-	if (png_sig_cmp(header, 0, header_size))
+}
+
+void Texture::load(const char *filename, const AssetPack *pack, TextureLoader *loader)
+{
+	const AssetPack::Entry *entry = pack ? pack->find(filename, AssetPack::TypeTexture) : nullptr;
+	if (entry)
 	{
-		cerr << "File is not a valid PNG: " << filename << endl;
-		return 0;
+		// Layers are cut from the top level, they build their own smaller levels
+		const uint8_t *pixels = pack->data(*entry);
+		if (texture_target == GL_TEXTURE_2D_ARRAY)
+		{
+			texture_id = uploadLayers(Image(entry->params[0], entry->params[1], pixels));
+		}
+		else
+		{
+			texture_id = upload(pixels, entry->params[0], entry->params[1], entry->params[2]);
+		}
+		ready = true;
+		return;
 	}
 
-	// Create data structures for reading
-    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-    if (!png_ptr)
+	if (loader)
 	{
-		cerr << "Failed to create libPNG header struct\n";
-		return 0;
+		this->loader = loader;
+		texture_id = placeholderTexture(texture_target);
+		loader->submit(*this, filename);
+		return;
 	}
 
-    png_infop info_ptr = png_create_info_struct(png_ptr);
-    if (!info_ptr)
-    {
-		png_destroy_read_struct(&png_ptr, nullptr, nullptr);
-		cerr << "Failed to create libPNG info struct\n";
-		return 0;
-    }
-
-	png_init_io(png_ptr, file);
-	png_set_sig_bytes(png_ptr, header_size);
+	texture_id = load_png(filename);
+	ready = texture_id != 0;
+}
 
-	// Read PNG info
-	png_read_info(png_ptr, info_ptr);
+void Texture::setImage(const Image &image)
+{
+	GLuint new_texture = texture_target == GL_TEXTURE_2D_ARRAY ? uploadLayers(image) : upload(image.data(), image.width(), image.height(), 1);
 
-	int width      = png_get_image_width(png_ptr, info_ptr);
-	int height     = png_get_image_height(png_ptr, info_ptr);
-	auto color_type = png_get_color_type(png_ptr, info_ptr);
-	auto bit_depth  = png_get_bit_depth(png_ptr, info_ptr);	
+	replace(begin(bound), end(bound), texture_id, 0u);
+	if (ready)
+	{
+		glDeleteTextures(1, &texture_id);
+	}
+	texture_id = new_texture;
+	ready = true;
+}
 
-	cout << "PNG texture to be loaded: " << filename << endl;
-	cout << "Width: " << width << endl;
-	cout << "Height: " << height << endl;
-	cout << "Color type: " << static_cast<int>(color_type) << endl;
-	cout << "Bit depth: " << static_cast<int>(bit_depth) << endl;
+GLuint Texture::placeholderTexture(GLenum target)
+{
+	GLuint &texture = target == GL_TEXTURE_2D_ARRAY ? placeholder_array : placeholder;
+	if (texture == 0)
+	{
+		const uint8_t grey[4] = { 128, 128, 128, 255 };
+		glGenTextures(1, &texture);
+		glBindTexture(target, texture);
+		fill(begin(bound), end(bound), 0);
+		if (target == GL_TEXTURE_2D_ARRAY)
+		{
+			glTexImage3D(target, 0, GL_RGB, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+		}
+		else
+		{
+			glTexImage2D(target, 0, GL_RGB, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+		}
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	return texture;
+}
+	
+void Texture::setUniform(Program &program, const char *name)
+{
+	program.use();
+	program.setUniform(name, static_cast<int>(unit));
+}
 
-	// Convert any color type to 8-bit RGBA
-	if (bit_depth == 16)
+void Texture::bind()
+{
+	if (unit < MaxUnits && bound[unit] == texture_id)
 	{
-		png_set_strip_16(png_ptr);
+		return;
 	}
 
-	if (color_type == PNG_COLOR_TYPE_PALETTE)
+	GL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
+	GL_CALL(glBindTexture(texture_target, texture_id));
+
+	if (unit < MaxUnits)
 	{
-		png_set_palette_to_rgb(png_ptr);
+		bound[unit] = texture_id;
 	}
+}
 
-	if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+GLuint Texture::load_png(const char*filename)
+{
+	Image image;
+	if (!image.loadPng(filename))
 	{
-		png_set_expand_gray_1_2_4_to_8(png_ptr);
+		return 0;
 	}
 
-	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+	if (texture_target == GL_TEXTURE_2D_ARRAY)
 	{
-		png_set_tRNS_to_alpha(png_ptr);
+		return uploadLayers(image);
 	}
+	return upload(image.data(), image.width(), image.height(), 1);
+}
+
+GLuint Texture::upload(const uint8_t *levels, int width, int height, int num_levels)
+{
+	// Now create GLES texture
+	GLuint new_texture;
+	glGenTextures(1, &new_texture);
+	glBindTexture(GL_TEXTURE_2D, new_texture);
 
-	if (color_type == PNG_COLOR_TYPE_RGB ||
-		color_type == PNG_COLOR_TYPE_GRAY ||
-		color_type == PNG_COLOR_TYPE_PALETTE)
+	// Whichever unit is active no longer has the texture that bind() put there
+	fill(begin(bound), end(bound), 0);
+	for (int level=0; level<num_levels; level++)
 	{
-		png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
+		const uint8_t *pixels = levels + AssetPack::levelOffset(width, height, level);
+		int level_width = max(width >> level, 1);
+		int level_height = max(height >> level, 1);
+		GL_UPLOAD(static_cast<size_t>(level_width) * level_height * 4,
+				  glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, level_width, level_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
 	}
 
-	if (color_type == PNG_COLOR_TYPE_GRAY ||
-		color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+	setFiltering(num_levels);
+	if (num_levels == 1)
 	{
-		png_set_gray_to_rgb(png_ptr);
+		glGenerateMipmap(GL_TEXTURE_2D);
 	}
 
-	png_read_update_info(png_ptr, info_ptr);
+	return new_texture;
+}
+
+GLuint Texture::uploadLayers(const Image &atlas)
+{
+	int columns = cell_size > 0 ? atlas.width() / cell_size : 0;
+	int rows = cell_size > 0 ? atlas.height() / cell_size : 0;
+	int num_levels = Image::numLevels(cell_size, cell_size);
+
+	GLuint new_texture;
+	glGenTextures(1, &new_texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, new_texture);
+	fill(begin(bound), end(bound), 0);
 
-	// Now read data
-	size_t row_size = png_get_rowbytes(png_ptr, info_ptr);
-	png_byte *data = new png_byte[row_size * height];
-	vector<png_bytep> row_pointers(height);
-	for (int i=0; i<height; i++)
+	// Storage for every level of every layer, then each layer is filled in
+	for (int level=0; level<num_levels; level++)
 	{
-		// Need to flip date over vertically as glTexImage2D expected data origin
-		// to be from the bottom left
-		row_pointers[height - i - 1] = &data[i * row_size];
+		int size = max(cell_size >> level, 1);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGB, size, size, static_cast<GLsizei>(cells.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 	}
 
-	png_read_image(png_ptr, row_pointers.data());
+	for (size_t layer=0; layer<cells.size(); layer++)
+	{
+		int cell = cells[layer];
+		if (cell < 0 || cell >= columns * rows)
+		{
+			cerr << "Texture layer " << layer << " is cell " << cell << ", outside of the " << columns << "x" << rows << " atlas\n";
+			continue;
+		}
+
+		// Image rows run from the bottom up, cells are counted from the top
+		Image image = atlas.crop((cell % columns) * cell_size, atlas.height() - (cell / columns + 1) * cell_size, cell_size, cell_size);
+		for (int level=0; level<num_levels; level++)
+		{
+			GL_UPLOAD(image.size(), glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, static_cast<GLint>(layer), image.width(), image.height(), 1,
+													GL_RGBA, GL_UNSIGNED_BYTE, image.data()));
+			image = image.halved();
+		}
+	}
 
-	// Now create GLES texture
-	GLuint texture_id;
-	glGenTextures(1, &texture_id);
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	setFiltering(num_levels);
+	return new_texture;
+}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+void Texture::setFiltering(int num_levels)
+{
+	glTexParameteri(texture_target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(texture_target, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 	// Set-up filtering
 	if (linearfiltering)
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(texture_target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(texture_target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	}
 	else
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(texture_target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(texture_target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
 	}
 
-	// Clean up
-	delete [] data;
-	png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
-	fclose(file);
-
-	return texture_id;
+	if (num_levels > 1)
+	{
+		glTexParameteri(texture_target, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+	}
 }
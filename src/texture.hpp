@@ -13,23 +13,76 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
 
+#include <vector>
+
+#include "program.hpp"
+#include "asset_pack.hpp"
+
+using namespace std;
+
+class Image;
+class TextureLoader;
+
 class Texture
 {
 public:
-	Texture(const char *filename, GLuint unit, bool linearfiltering);
+	/// Load a PNG, or its already decoded mip chain when the pack has the same path. With a loader
+	/// the PNG is decoded in the background and the texture is a placeholder until it is uploaded.
+	Texture(const char *filename, GLuint unit, bool linearfiltering, const AssetPack *pack = nullptr, TextureLoader *loader = nullptr);
+
+	/// Cut square cells out of an atlas into the layers of a GL_TEXTURE_2D_ARRAY, layer n from
+	/// cells[n]. Cells are numbered across and then down from the top left. Each layer gets its own
+	/// mip chain and repeats, so nothing bleeds in from neighbouring cells.
+	Texture(const char *filename, int cell_size, const vector<int> &cells, GLuint unit, bool linearfiltering,
+			const AssetPack *pack = nullptr, TextureLoader *loader = nullptr);
 	virtual ~Texture();
-	
-	void setUniform(GLuint program_id, const char *name);
+
+	Texture(const Texture &) = delete;
+	Texture &operator=(const Texture &) = delete;
+
+	/// False while the placeholder is showing.
+	bool isReady() const { return ready; }
+
+	/// Replace the texture with a decoded image. Called by TextureLoader on the render thread.
+	void setImage(const Image &image);
+
+	void setUniform(Program &program, const char *name);
+
+	// Binding is skipped when the texture is already bound to its unit
 	void bind();
 
+	GLuint id() const { return texture_id; }
+	GLenum target() const { return texture_target; }
+
 private:
+	void load(const char *filename, const AssetPack *pack, TextureLoader *loader);
 	GLuint load_png(const char*filename);
 
+	// Create the texture from RGBA levels, generating the rest of the chain if only one is given
+	GLuint upload(const uint8_t *levels, int width, int height, int num_levels);
+	GLuint uploadLayers(const Image &atlas);
+	void setFiltering(int num_levels);
+
 	bool linearfiltering = false;
 
 	GLuint unit;
-	GLuint id;
-	GLuint uniform_id;
+	GLuint texture_id = 0;
+	GLenum texture_target = GL_TEXTURE_2D;
+	bool ready = false;
+	TextureLoader *loader = nullptr;
+
+	// Atlas cells making up the layers of an array texture
+	int cell_size = 0;
+	vector<int> cells;
+
+	// Grey shown by every texture still being loaded, created when first needed
+	inline static GLuint placeholder = 0;
+	inline static GLuint placeholder_array = 0;
+	static GLuint placeholderTexture(GLenum target);
+
+	// Texture bound to each unit by bind(), zero when unknown
+	static constexpr GLuint MaxUnits = 32;
+	inline static GLuint bound[MaxUnits] = {0};
 };
 
 #endif
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "texture_loader.hpp"
+
+TextureLoader::TextureLoader(unsigned num_threads)
+{
+	if (num_threads == 0)
+	{
+		unsigned hardware_threads = thread::hardware_concurrency();
+		num_threads = hardware_threads > 1 ? hardware_threads - 1 : 1;
+	}
+
+	for (unsigned i=0; i<num_threads; i++)
+	{
+		workers.emplace_back(&TextureLoader::run, this);
+	}
+}
+
+TextureLoader::~TextureLoader()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	work_ready.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void TextureLoader::submit(Texture &texture, const string &filename)
+{
+	Job job;
+	job.texture = &texture;
+	job.filename = filename;
+	job.decoded = false;
+
+	{
+		lock_guard<mutex> guard(lock);
+		job.id = next_id++;
+		queued.push_back(move(job));
+	}
+	work_ready.notify_one();
+}
+
+void TextureLoader::cancel(Texture &texture)
+{
+	lock_guard<mutex> guard(lock);
+
+	auto is_texture = [&texture](const Job &job) { return job.texture == &texture; };
+	queued.erase(remove_if(queued.begin(), queued.end(), is_texture), queued.end());
+	finished.erase(remove_if(finished.begin(), finished.end(), is_texture), finished.end());
+
+	// Workers check this list before handing their results over
+	in_flight.erase(remove_if(in_flight.begin(), in_flight.end(),
+							  [&texture](const pair<uint64_t, Texture*> &entry) { return entry.second == &texture; }),
+					in_flight.end());
+	work_done.notify_all();
+}
+
+size_t TextureLoader::upload(float budget_ms)
+{
+	auto start = chrono::steady_clock::now();
+	size_t uploaded = 0;
+
+	while (true)
+	{
+		Job job;
+		{
+			lock_guard<mutex> guard(lock);
+			if (finished.empty())
+			{
+				break;
+			}
+
+			job = move(finished.front());
+			finished.pop_front();
+		}
+
+		// Textures that failed to decode keep the placeholder, the worker has said why
+		if (job.decoded)
+		{
+			job.texture->setImage(job.image);
+			uploaded++;
+		}
+
+		chrono::duration<float, milli> elapsed = chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budget_ms)
+		{
+			break;
+		}
+	}
+
+	return uploaded;
+}
+
+void TextureLoader::finish()
+{
+	while (true)
+	{
+		{
+			unique_lock<mutex> guard(lock);
+			work_done.wait(guard, [this] { return !finished.empty() || (queued.empty() && in_flight.empty()); });
+			if (finished.empty())
+			{
+				return;
+			}
+		}
+
+		upload(numeric_limits<float>::max());
+	}
+}
+
+size_t TextureLoader::pending() const
+{
+	lock_guard<mutex> guard(lock);
+	return queued.size() + in_flight.size() + finished.size();
+}
+
+void TextureLoader::run()
+{
+	while (true)
+	{
+		Job job;
+		{
+			unique_lock<mutex> guard(lock);
+			work_ready.wait(guard, [this] { return stopping || !queued.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			job = move(queued.front());
+			queued.pop_front();
+
+			in_flight.push_back(make_pair(job.id, job.texture));
+		}
+
+		job.decoded = job.image.loadPng(job.filename.c_str());
+
+		{
+			lock_guard<mutex> guard(lock);
+
+			// The texture was cancelled while being decoded
+			auto entry = find_if(in_flight.begin(), in_flight.end(),
+								 [&job](const pair<uint64_t, Texture*> &entry) { return entry.first == job.id; });
+			if (entry == in_flight.end())
+			{
+				continue;
+			}
+
+			in_flight.erase(entry);
+			finished.push_back(move(job));
+		}
+		work_done.notify_all();
+	}
+}
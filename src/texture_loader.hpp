@@ -0,0 +1,75 @@
+#ifndef __TEXTURE_LOADER_HPP__
+#define __TEXTURE_LOADER_HPP__
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <utility>
+
+#include "texture.hpp"
+#include "image.hpp"
+
+using namespace std;
+
+/**
+ * Decodes PNG textures on background threads so that loading many of them doesn't hold up the
+ * render thread. A texture given a loader shows a placeholder until the render thread calls
+ * upload(), which creates the GL texture from the decoded image. Textures are decoded in the
+ * order they were submitted.
+ */
+class TextureLoader
+{
+public:
+	/// Zero threads picks one less than the number of hardware threads (but at least one).
+	TextureLoader(unsigned num_threads = 0);
+	~TextureLoader();
+
+	/// Queue a texture to be decoded from a PNG file. Texture does this when it is given a loader.
+	void submit(Texture &texture, const string &filename);
+
+	/// Forget about a texture, e.g. before it is destroyed. Images already being decoded are dropped.
+	void cancel(Texture &texture);
+
+	/// Upload decoded images until the time budget is spent. At least one image is uploaded per
+	/// call when available. Returns the number uploaded.
+	size_t upload(float budget_ms);
+
+	/// Upload everything submitted so far, waiting for it to be decoded.
+	void finish();
+
+	/// Textures that have been submitted but not yet uploaded.
+	size_t pending() const;
+
+	size_t numThreads() const { return workers.size(); }
+
+private:
+	struct Job
+	{
+		uint64_t id;
+		Texture *texture;
+		string filename;
+		Image image;
+		bool decoded;
+	};
+
+	void run();
+
+	vector<thread> workers;
+
+	mutable mutex lock;
+	condition_variable work_ready;
+	condition_variable work_done;
+	bool stopping = false;
+
+	uint64_t next_id = 0;
+
+	deque<Job> queued;
+	vector<pair<uint64_t, Texture*>> in_flight;
+	deque<Job> finished;
+};
+
+#endif // __TEXTURE_LOADER_HPP__
@@ -6,15 +6,12 @@
 // Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
 #include <GL/glew.h>
 
+#include "utility.hpp"
+
 using namespace std;
 
 GLuint load_shaders(const char * vertex_file_path,const char * fragment_file_path)
 {
-
-	// Create the shaders
-	GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
-	GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-
 	// Read the Vertex Shader code from the file
 	string vertex_shader_code;
 	ifstream vertex_shader_stream(vertex_file_path, ios::in);
@@ -46,12 +43,21 @@ GLuint load_shaders(const char * vertex_file_path,const char * fragment_file_pat
 		fragment_shader_stream.close();
 	}
 
+	return compile_shaders(vertex_shader_code.c_str(), fragment_shader_code.c_str(), vertex_file_path, fragment_file_path);
+}
+
+GLuint compile_shaders(const char * vertex_shader_code, const char * fragment_shader_code, const char * vertex_name, const char * fragment_name)
+{
+	// Create the shaders
+	GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
+	GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
+
 	GLint result = GL_FALSE;
 	int info_log_length;
 
 	// Compile Vertex Shader
-	cout << "Compiling shader: " << vertex_file_path << endl;
-	char const * vertex_source_pointer = vertex_shader_code.c_str();
+	cout << "Compiling shader: " << vertex_name << endl;
+	char const * vertex_source_pointer = vertex_shader_code;
 	glShaderSource(vertex_shader_id, 1, &vertex_source_pointer , NULL);
 	glCompileShader(vertex_shader_id);
 
@@ -70,8 +76,8 @@ GLuint load_shaders(const char * vertex_file_path,const char * fragment_file_pat
 	}
 
 	// Compile Fragment Shader
-	cout << "Compiling shader: " << fragment_file_path << endl;
-	char const * fragment_source_pointer = fragment_shader_code.c_str();
+	cout << "Compiling shader: " << fragment_name << endl;
+	char const * fragment_source_pointer = fragment_shader_code;
 	glShaderSource(fragment_shader_id, 1, &fragment_source_pointer , NULL);
 	glCompileShader(fragment_shader_id);
 
@@ -3,5 +3,8 @@
 
 GLuint load_shaders(const char * vertex_file_path,const char * fragment_file_path);
 
+// Compile and link shader source that is already in memory, the names are only for messages
+GLuint compile_shaders(const char * vertex_shader_code, const char * fragment_shader_code, const char * vertex_name, const char * fragment_name);
+
 #endif // __UTILITY_HPP__
 
@@ -1,222 +1,151 @@
-#include <fstream>
 #include <iostream>
-#include <sstream>
-#include <limits>
 #include "wavefront_obj.hpp"
+#include "mesh_optimizer.hpp"
+#include "gl_stats.hpp"
 
 using namespace std;
 
-void WavefrontObj::generateData()
+WavefrontObj::WavefrontObj(const char *filename, const AssetPack *pack) : m_filename(filename)
 {
-	ifstream file(m_filename, ifstream::in);
-	string line;
-	unsigned line_num = 0;
+	const AssetPack::Entry *entry = pack ? pack->find(filename, AssetPack::TypeMesh) : nullptr;
+	if (entry && entry->params[2] == ObjParser::Stride)
+	{
+		// Buffers are filled straight from the mapped pack
+		const float *vertices = reinterpret_cast<const float*>(pack->data(*entry));
+		const GLuint *indices = reinterpret_cast<const GLuint*>(vertices + entry->params[0] * ObjParser::Stride);
+		createBuffers(vertices, entry->params[0], indices, entry->params[1]);
+		return;
+	}
 
-	vector<float> vertices;
-	vector<float> tex_coords;
-	vector<float> normals;
+	generateData();
+	createBuffers(m_vertices.data(), m_vertices.size() / ObjParser::Stride, m_indices.data(), m_indices.size());
+}
 
-	while (file.good())
+void WavefrontObj::generateData()
+{
+	ObjParser::Mesh mesh;
+	ObjParser::Stats stats;
+	if (!ObjParser::load(m_filename, mesh, &stats))
 	{
-		getline(file, line);
-		line_num++;
+		return;
+	}
 
-		istringstream in(line);
+	cout << "Loaded " << m_filename << ": " << stats.faces << " faces, " << stats.bytes / (1024.0f * 1024.0f) << " MB in " <<
+		stats.milliseconds << " ms (" << stats.megabytesPerSecond() << " MB/s)\n";
+	if (stats.bad_indices > 0)
+	{
+		cerr << m_filename << " has " << stats.bad_indices << " face corners referring to missing elements\n";
+	}
 
-		string type;
-		in >> type;
+	// Order triangles to reuse shaded vertices, then vertices to be read in order
+	float before = MeshOptimizer::averageCacheMissRatio(mesh.indices, mesh.numVertices());
+	MeshOptimizer::optimizeVertexCache(mesh.indices, mesh.numVertices());
+	MeshOptimizer::optimizeVertexFetch(mesh.vertices, ObjParser::Stride, mesh.indices);
+	float after = MeshOptimizer::averageCacheMissRatio(mesh.indices, mesh.numVertices());
+	cout << "  " << stats.corners << " corners shared as " << mesh.numVertices() << " vertices, " <<
+		before << " -> " << after << " vertices shaded per triangle\n";
 
-		if (type == "#")
-		{
-			// Comment
-			continue;
-		}
-		else if (type == "v")
-		{
-			// Vertex
-			float x, y, z, w;
-			x = y = z = 0.0f;
-			w = 1.0f;
-	  		in >> x >> y >> z >> w;
-			vertices.push_back(x);
-			vertices.push_back(y);
-			vertices.push_back(z);
-		}
-		else if (type == "vt")
-		{
-			// Texture vertices
-			float u, v, w;
-			u = v = w = 0.0f;
-			in >> u >> v >> w;
-			tex_coords.push_back(u);
-			tex_coords.push_back(v);
-		}
-		else if (type == "vn")
-		{
-			// Vertex normals
-			float dx, dy, dz;
-			dx = dy = dz = 0.0f;
-			in >> dx >> dy >> dz;
-			normals.push_back(dx);
-			normals.push_back(dy);
-			normals.push_back(dz);
-		}
-		else if (type == "f")
+	m_vertices = move(mesh.vertices);
+	m_indices = move(mesh.indices);
+}
+
+void WavefrontObj::createBuffers(const float *vertices, size_t vertex_count, const GLuint *indices, size_t index_count)
+{
+	num_vertices = vertex_count;
+	num_indices = index_count;
+
+	// Box around the model for culling
+	for (size_t i=0; i<vertex_count; i++)
+	{
+		const float *position = vertices + i * ObjParser::Stride;
+		glm::vec3 point(position[0], position[1], position[2]);
+		if (i == 0)
 		{
-			vector<unsigned> f;
-			vector<unsigned> ft;
-			vector<unsigned> fn;
-			unsigned tmp;
-
-			while (!in.eof())
-			{
-				// Vertex
-				in >> tmp;
-				f.push_back(tmp);
-
-				// Texture coordinate
-				if (in.peek() != '/')
-				{
-					continue;
-				}
-				else
-				{
-					in.ignore();
-					if (in.peek() != '/')
-					{
-						in >> tmp;
-						ft.push_back(tmp);
-					}
-				}
-
-				// Normal
-				if (in.peek() != '/')
-				{
-					continue;
-				}
-				else
-				{
-					in.ignore();
-					in >> tmp;
-					fn.push_back(tmp);
-				}
-			}
-
-			// Now store values
-			// Assume only triangles for now
-			if (f.size() >= 3)
-			{
-				// OBJ indices start at 1 not zero
-				for (int i=0; i<3; i++)
-				{
-					size_t findex = (f[i]-1) * 3;
-					m_vertices.push_back(vertices[findex+0]); // X
-					m_vertices.push_back(vertices[findex+1]); // Y
-					m_vertices.push_back(vertices[findex+2]); // Z
-				}
-
-				if (ft.size() > 0)
-				{
-					for (int i=0; i<3; i++)
-					{
-						size_t findex = (ft[i]-1) * 2;
-						m_tex_coords.push_back(tex_coords[findex+0]); // U
-						m_tex_coords.push_back(tex_coords[findex+1]); // V
-					}
-				}
-
-				if (fn.size() > 0)
-				{
-					for (int i=0; i<3; i++)
-					{
-						size_t findex = (fn[i]-1) * 3;
-						m_normals.push_back(normals[findex+0]); // dX
-						m_normals.push_back(normals[findex+1]); // dY
-						m_normals.push_back(normals[findex+2]); // dZ
-					}
-				}
-			}
+			m_bounds = AABB(point, point);
 		}
+		m_bounds.min = glm::min(m_bounds.min, point);
+		m_bounds.max = glm::max(m_bounds.max, point);
 	}
-}
 
-void WavefrontObj::createBuffers()
-{
 	// Create the buffers
 	glGenVertexArrays(1, &vertex_array_id);
 	glBindVertexArray(vertex_array_id);
 
 	glGenBuffers(1, &vertex_buffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), m_vertices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertex_count * ObjParser::Stride * sizeof(float), vertices, GL_STATIC_DRAW);
 
-	glGenBuffers(1, &uv_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uv_buffer);
-	glBufferData(GL_ARRAY_BUFFER, m_tex_coords.size() * sizeof(float), m_tex_coords.data(), GL_STATIC_DRAW);
+	glGenBuffers(1, &index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(GLuint), indices, GL_STATIC_DRAW);
 
-	glGenBuffers(1, &normal_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normal_buffer);
-	glBufferData(GL_ARRAY_BUFFER, m_normals.size() * sizeof(float), m_normals.data(), GL_STATIC_DRAW);
+	setupAttributes();
+}
 
-	// First attribute buffer : vertices
-	glEnableVertexAttribArray(0);
+void WavefrontObj::setupAttributes()
+{
+	// Element buffer binding is part of the vertex array state
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+
+	// Position, texture coords and normal are interleaved in one buffer
+	const GLsizei stride = ObjParser::Stride * sizeof(float);
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+
+	// First attribute: vertices
+	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(
 		0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
 		3,                  // size
 		GL_FLOAT,           // type
 		GL_FALSE,           // normalized?
-		0,                  // stride
+		stride,             // stride
 		(void*)0            // array buffer offset
 		);
 
-	// Second attribute buffer: texture coords
+	// Second attribute: texture coords
 	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, uv_buffer);
 	glVertexAttribPointer(
 		1,
 		2,
 		GL_FLOAT,
 		GL_TRUE,
-		0,
-		(void*)0
+		stride,
+		(void*)(ObjParser::TexCoordOffset * sizeof(float))
 		);
 
-	// Third attribute buffer: normals
+	// Third attribute: normals
 	glEnableVertexAttribArray(2);
-	glBindBuffer(GL_ARRAY_BUFFER, normal_buffer);
 	glVertexAttribPointer(
 		2,
 		3,
 		GL_FLOAT,
 		GL_TRUE,
-		0,
-		(void*)0
+		stride,
+		(void*)(ObjParser::NormalOffset * sizeof(float))
 		);
 }
 
 void WavefrontObj::bindBuffers()
 {
-	glBindVertexArray(vertex_array_id);
+	GL_CALL(glBindVertexArray(vertex_array_id));
 }
 
 void WavefrontObj::dump()
 {
 	cout << "Vertices:\n";
-	for (size_t i=0; i<m_vertices.size(); i+=3)
-	{
-		cout << i/3 << "   X: " << m_vertices[i] << "   Y: " << m_vertices[i+1] << "   Z: " << m_vertices[i+2] << endl;
-	}
-
-	cout << "Texture Coords:\n";
-	for (size_t i=0; i<m_tex_coords.size(); i+=2)
+	for (size_t i=0; i<m_vertices.size(); i+=ObjParser::Stride)
 	{
-		cout << i/2 << "   U: " << m_tex_coords[i] << "   V: " << m_tex_coords[i+1] << endl;
+		const float *position = &m_vertices[i];
+		const float *uv = position + ObjParser::TexCoordOffset;
+		const float *normal = position + ObjParser::NormalOffset;
+		cout << i/ObjParser::Stride << "   X: " << position[0] << "   Y: " << position[1] << "   Z: " << position[2] <<
+			"   U: " << uv[0] << "   V: " << uv[1] <<
+			"   dX: " << normal[0] << "   dY: " << normal[1] << "   dZ: " << normal[2] << endl;
 	}
 
-	cout << "Normals:\n";
-	for (size_t i=0; i<m_normals.size(); i+=3)
+	cout << "Indices:\n";
+	for (size_t i=0; i<m_indices.size(); i+=3)
 	{
-		cout << i/3 << "   dX: " << m_normals[i] << "   dY: " << m_normals[i+1] << "   dZ: " << m_normals[i+2] << endl;
+		cout << i/3 << "   " << m_indices[i] << " " << m_indices[i+1] << " " << m_indices[i+2] << endl;
 	}
 }
@@ -16,6 +16,10 @@
 #include <vector>
 #include <string>
 
+#include "frustum.hpp"
+#include "obj_parser.hpp"
+#include "asset_pack.hpp"
+
 using namespace std;
 
 /**
@@ -24,32 +28,40 @@ using namespace std;
 class WavefrontObj
 {
 public:
-	/// Constructors.
-	WavefrontObj(const char *filename) : m_filename(filename) { generateData(); createBuffers(); }
+	/// Constructors. Loads the model parsed by orbis_pack when the pack has the same path.
+	WavefrontObj(const char *filename, const AssetPack *pack = nullptr);
 
 	/// Destructors.
 	~WavefrontObj() {}
 
+	/// Print the vertices and triangles, only kept for models read from OBJ files.
 	void dump();
-	size_t numVertices() const { return m_vertices.size(); }
+	size_t numVertices() const { return num_vertices; }
+	size_t numIndices() const { return num_indices; }
+	const AABB &bounds() const { return m_bounds; }
 
 	void bindBuffers();
+	GLuint vertexArray() const { return vertex_array_id; }
+
+	/// Point attributes 0 to 2 and the element buffer of the bound vertex array at this object's buffers.
+	void setupAttributes();
 
 private:
 	/// Generate data from file
 	void generateData();
-	void createBuffers();
+	void createBuffers(const float *vertices, size_t vertex_count, const GLuint *indices, size_t index_count);
 
 	/// Instance variables
 	const char *m_filename;
-	vector<float> m_vertices;
-	vector<float> m_tex_coords;
-	vector<float> m_normals;
+	vector<float> m_vertices; // Interleaved position, texture coords and normal
+	vector<GLuint> m_indices;
+	AABB m_bounds;
+	size_t num_vertices = 0;
+	size_t num_indices = 0;
 
 	GLuint vertex_array_id;
 	GLuint vertex_buffer;
-	GLuint uv_buffer;
-	GLuint normal_buffer;
+	GLuint index_buffer;
 };
 
 #endif // __WAVEFRONT_OBJ_HPP__
@@ -2,7 +2,7 @@
 #include <iostream>
 #include "window.hpp"
 
-Window::Window(int width, int height, const char *title) : width(width), height(height),
+Window::Window(int width, int height, const char *title, bool headless) : width(width), height(height),
 														   xposoffset(static_cast<double>(width) / 2.0),
 														   yposoffset(static_cast<double>(height) / 2.0)
 {
@@ -12,7 +12,23 @@ Window::Window(int width, int height, const char *title) : width(width), height(
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // We don't want the old OpenGL 
 
-	window = glfwCreateWindow(width, height, title, NULL, NULL);
+	if (headless)
+	{
+		// Surfaceless EGL where the driver has it, otherwise Mesa's offscreen renderer
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+		window = glfwCreateWindow(width, height, title, NULL, NULL);
+		if (window == NULL)
+		{
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+			window = glfwCreateWindow(width, height, title, NULL, NULL);
+		}
+	}
+	else
+	{
+		window = glfwCreateWindow(width, height, title, NULL, NULL);
+	}
+
 	if (window == NULL)
 	{
 		cerr << "Failed to open GLFW window.\n";
@@ -35,6 +51,13 @@ Window::~Window()
 	glfwDestroyWindow(window);
 }
 
+void Window::useNullPlatform()
+{
+#ifdef GLFW_PLATFORM_NULL
+	glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+}
+
 void Window::setTitle(const char *title)
 {
 	glfwSetWindowTitle(window, title);
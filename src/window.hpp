@@ -20,9 +20,14 @@ using namespace std;
 class Window
 {
 public:
-	Window(int width, int height, const char *title);
+	/// A headless window is never shown and renders offscreen, see useNullPlatform().
+	Window(int width, int height, const char *title, bool headless = false);
 	virtual ~Window();
 
+	/// Run without a display, e.g. on build machines with only a software renderer. Call before
+	/// glfwInit. Needs GLFW 3.4, older versions fall back to a hidden window on the usual platform.
+	static void useNullPlatform();
+
 	void setTitle(const char *title);
 	bool isKeyPressed(int glfwKey) const { return key_pressed[glfwKey]; }
 	void getMousePos(double &xpos, double &ypos);